@@ -0,0 +1,78 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#ifndef CONFIG_CACHE_H
+#define CONFIG_CACHE_H
+
+#include <ros/ros.h>
+
+#include <map>
+#include <boost/thread/mutex.hpp>
+
+/**
+ * Board configuration saved on disk between launches.
+ *
+ * There is a file for every board name and type under
+ * $ROS_HOME/orbus_interface, valid only for the firmware version and
+ * build date that wrote it. The configurators copy a namespace from the
+ * cache to the parameter server instead of reading it from the board,
+ * and store every namespace read from the board or written on it.
+ */
+class ConfigCache {
+public:
+    ConfigCache();
+
+    /// Load the file of this board, dropped if written by another firmware
+    void open(const std::string& name, const std::string& type, const std::string& version, const std::string& date);
+
+    /// Copy a cached namespace on the parameter server
+    bool restore(const ros::NodeHandle& nh, const std::string& name);
+    /// Copy a namespace from the parameter server in the cache
+    void store(const ros::NodeHandle& nh, const std::string& name);
+    /// Like store, postponed to the next save: safe from the serial threads
+    void changed(const ros::NodeHandle& nh, const std::string& name);
+
+    /// Store the changed namespaces and write the file if the cache is changed
+    bool save();
+
+private:
+    std::string path_;
+    std::string version_, date_;
+    /// Cached namespaces
+    XmlRpc::XmlRpcValue params_;
+    bool loaded_, dirty_;
+    /// Namespaces written on the board since the last save
+    boost::mutex mutex_;
+    std::map<std::string, ros::NodeHandle> changed_;
+};
+
+#endif // CONFIG_CACHE_H
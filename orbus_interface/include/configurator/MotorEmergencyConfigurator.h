@@ -30,15 +30,32 @@
 */
 
 #include "serial_parser_packet/ParserPacket.h"
+#include "configurator/ConfigCache.h"
+#include "configurator/ShadowSync.h"
+#include "transport/StartupPlanner.h"
 
 #include <ros/ros.h>
 
+#include <boost/atomic.hpp>
+
 #include <dynamic_reconfigure/server.h>
 #include <orbus_interface/UnavEmergencyConfig.h>
 
 class MotorEmergencyConfigurator {
 public:
-    MotorEmergencyConfigurator(const ros::NodeHandle& nh, std::string name, unsigned int number, ParserPacket* serial);
+    MotorEmergencyConfigurator(const ros::NodeHandle& nh, std::string name, unsigned int number, ParserPacket* serial, ShadowSync* shadow);
+
+    /// Add the startup messages, the answers are decoded before initialize
+    void plan(StartupPlanner* planner, ConfigCache* cache);
+    /// Start the dynamic reconfigure server
+    void initialize();
+
+    /// Emergency configuration on the parameter server
+    motor_emergency_t getEmergency();
+    /// Timeout of the references of the last configuration, 0 before initialize [ms]
+    unsigned int timeout() const {
+        return timeout_;
+    }
 private:
     /// Associate name space
     std::string name_;
@@ -46,13 +63,20 @@ private:
     ros::NodeHandle nh_;
     /// Serial port
     ParserPacket* serial_;
+    /// Configuration confirmed by the board
+    ShadowSync* shadow_;
+    /// Configuration saved from the last launch
+    ConfigCache* cache_;
     /// Command map
     motor_command_map_t command_;
 
     motor_emergency_t last_emergency_, default_emer_;
+    /// Timeout of last_emergency_, read by the diagnostic thread
+    boost::atomic<unsigned int> timeout_;
 
     bool setup_;
 
     dynamic_reconfigure::Server<orbus_interface::UnavEmergencyConfig> *dsrv_;
+    void decodeReply(const packet_information_t& packet);
     void reconfigureCB(orbus_interface::UnavEmergencyConfig &config, uint32_t level);
 };
@@ -30,6 +30,9 @@
 */
 
 #include "serial_parser_packet/ParserPacket.h"
+#include "configurator/ConfigCache.h"
+#include "configurator/ShadowSync.h"
+#include "transport/StartupPlanner.h"
 
 #include <ros/ros.h>
 
@@ -38,10 +41,15 @@
 
 class MotorPIDConfigurator {
 public:
-    MotorPIDConfigurator(const ros::NodeHandle& nh, std::string name, unsigned int number, ParserPacket* serial);
+    MotorPIDConfigurator(const ros::NodeHandle& nh, std::string name, unsigned int number, ParserPacket* serial, ShadowSync* shadow);
 
-    void setParam(motor_parameter_t parameter);
-    motor_parameter_t getParam();
+    /// Add the startup messages, the answers are decoded before initialize
+    void plan(StartupPlanner* planner, ConfigCache* cache);
+    /// Start the dynamic reconfigure server
+    void initialize();
+
+    /// PID on the parameter server
+    motor_pid_t getPID();
 
 private:
     /// Associate name space
@@ -50,6 +58,10 @@ private:
     ros::NodeHandle nh_;
     /// Serial port
     ParserPacket* serial_;
+    /// Configuration confirmed by the board
+    ShadowSync* shadow_;
+    /// Configuration saved from the last launch
+    ConfigCache* cache_;
     /// Command map
     motor_command_map_t command_;
     /// Frequency message
@@ -59,8 +71,6 @@ private:
     bool setup_;
 
     dynamic_reconfigure::Server<orbus_interface::UnavPIDConfig> *dsrv_;
+    void decodeReply(const packet_information_t& packet);
     void reconfigureCB(orbus_interface::UnavPIDConfig &config, uint32_t level);
-
-    /// Send to serial
-    void sendToSerial(std::vector<packet_information_t>& list_send);
 };
@@ -30,6 +30,9 @@
 */
 
 #include "serial_parser_packet/ParserPacket.h"
+#include "configurator/ConfigCache.h"
+#include "configurator/ShadowSync.h"
+#include "transport/StartupPlanner.h"
 
 #include <ros/ros.h>
 
@@ -38,7 +41,12 @@
 
 class MotorParamConfigurator {
 public:
-    MotorParamConfigurator(const ros::NodeHandle& nh, std::string name, unsigned int number, ParserPacket* serial);
+    MotorParamConfigurator(const ros::NodeHandle& nh, std::string name, unsigned int number, ParserPacket* serial, ShadowSync* shadow);
+
+    /// Add the startup messages, the answers are decoded before initialize
+    void plan(StartupPlanner* planner, ConfigCache* cache);
+    /// Start the dynamic reconfigure server
+    void initialize();
 
     void setParam(motor_parameter_t parameter);
     motor_parameter_t getParam();
@@ -51,6 +59,10 @@ private:
     ros::NodeHandle nh_;
     /// Serial port
     ParserPacket* serial_;
+    /// Configuration confirmed by the board
+    ShadowSync* shadow_;
+    /// Configuration saved from the last launch
+    ConfigCache* cache_;
     /// Command map
     motor_command_map_t command_;
     /// Frequency message
@@ -61,8 +73,6 @@ private:
     bool setup_;
 
     dynamic_reconfigure::Server<orbus_interface::UnavParameterConfig> *dsrv_;
+    void decodeReply(const packet_information_t& packet);
     void reconfigureCB(orbus_interface::UnavParameterConfig &config, uint32_t level);
-
-    /// Send to serial
-    void sendToSerial(motor_parameter_t parameter);
 };
@@ -0,0 +1,124 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#ifndef SHADOW_SYNC_H
+#define SHADOW_SYNC_H
+
+#include "serial_parser_packet/ParserPacket.h"
+#include "transport/SerialExecutor.h"
+#include "transport/StartupPlanner.h"
+
+#include <map>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+/**
+ * Copy of the configuration confirmed by the board.
+ *
+ * The configurators stage the value that every message must have on the
+ * board. flush() sends, in a single exchange, only the staged values that
+ * differ from the last value read from the board or acknowledged by it.
+ * Staged values are latest-wins: a value changed many times between two
+ * flushes is sent once.
+ * Padding bytes are compared too: the staged structures must be zeroed
+ * before they are filled.
+ */
+class ShadowSync {
+public:
+    ShadowSync(ParserPacket* serial, SerialExecutor* executor);
+
+    /// Value of a message that the board must have, the last staged wins
+    void stage(unsigned char type, unsigned char command, const void* data, size_t length);
+    /// Value read from the board
+    void confirm(unsigned char type, unsigned char command, const void* data, size_t length);
+
+    /// Called on the serial thread when the board acknowledges the last staged value
+    void acknowledged(unsigned char type, unsigned char command, boost::function<void ()> callback);
+
+    /// Add a read of the board value to the planner, the answer is confirmed
+    void read(StartupPlanner* planner, unsigned char type, unsigned char command, size_t length);
+
+    /**
+     * Send the staged values that differ from the board
+     * @return number of messages sent
+     */
+    unsigned int flush();
+
+    /**
+     * Like flush, without waiting the answers
+     * @return number of messages queued, 0 also if the last post is still in progress
+     */
+    unsigned int post();
+
+    /// Messages staged and not yet sent
+    unsigned int staged();
+    /// Messages sent without answer, staged again for the next flush
+    unsigned long lost() const {
+        return lost_;
+    }
+
+private:
+    struct entry_t {
+        unsigned char type, command;
+        size_t length;
+        /// Last value confirmed by the board
+        bool valid;
+        message_abstract_u confirmed;
+        /// Value waiting to be sent
+        bool staged;
+        message_abstract_u pending;
+    };
+    typedef std::map<unsigned int, entry_t> shadow_map_t;
+    typedef std::map<unsigned int, boost::function<void ()> > callback_map_t;
+
+    ParserPacket* serial_;
+    SerialExecutor* executor_;
+    boost::mutex mutex_;
+    shadow_map_t shadow_;
+    callback_map_t acknowledged_;
+    /// A post is waiting for the answers
+    boost::atomic<bool> posting_;
+    boost::atomic<unsigned long> lost_;
+
+    /// Must be called with mutex_ locked
+    entry_t& entry(unsigned char type, unsigned char command, size_t length);
+    /// Add to the planner the staged values different from the board
+    void collect(StartupPlanner* planner);
+    /// The planner is bound only to live until the answers are dispatched
+    void posted(boost::shared_ptr<StartupPlanner>, unsigned int lost);
+    void readReply(unsigned char type, unsigned char command, size_t length, const packet_information_t& packet);
+    void writeReply(unsigned char type, unsigned char command, message_abstract_u sent, const packet_information_t& packet);
+};
+
+#endif // SHADOW_SYNC_H
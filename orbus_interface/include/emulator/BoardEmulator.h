@@ -0,0 +1,130 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#ifndef BOARD_EMULATOR_H
+#define BOARD_EMULATOR_H
+
+#include "transport/ORBusFrame.h"
+
+#include <string>
+#include <vector>
+
+#define EMULATOR_MOTORS 2
+
+/**
+ * µNAV board emulated at the protocol level.
+ *
+ * It decodes the frames written by the driver and answers like the
+ * board: identity services, measures, velocity references and motor
+ * configuration. Every motor is a first order model of the velocity,
+ * stopped by the emergency timeout when the references stop.
+ */
+class BoardEmulator {
+public:
+    struct options_t {
+        std::string name, type, version, author, date;
+        /// Time constant of the velocity of the motors [s]
+        double time_constant;
+
+        options_t() : name("uNAV"), type("Motor Control"), version("emulator"), author("Officine Robotiche"),
+            date(__DATE__), time_constant(0.05) {
+        }
+    };
+
+    BoardEmulator(const options_t& options = options_t());
+
+    /// Bytes written by the driver, the frames to send back are appended to reply
+    void receive(const unsigned char* data, size_t length, std::vector<unsigned char>* reply);
+
+    /// Move the motors forward of dt seconds
+    void step(double dt);
+
+    /// Frames answered
+    unsigned int frames() const {
+        return frames_;
+    }
+    /// Position of a motor sent with the measures [rad], read with the emulator stopped
+    double positionSent(unsigned int motor) const {
+        return motors_[motor].position_sent;
+    }
+    /// Frames dropped for a wrong header, length or checksum
+    unsigned int errors() const {
+        return errors_;
+    }
+
+private:
+    struct motor_emulator_t {
+        motor_pid_t pid;
+        motor_parameter_t parameter;
+        motor_emergency_t emergency;
+        motor_t constraint;
+        motor_state_t state;
+        /// Velocity reference and velocity [rad/s], position [rad]
+        double reference, velocity, position;
+        /// Position already sent with the measures [rad]
+        double position_sent;
+        /// Time from the last velocity reference [s]
+        double reference_age;
+    };
+
+    enum state_t {
+        WAIT_HEADER,
+        WAIT_LENGTH,
+        WAIT_DATA,
+        WAIT_CHECKSUM
+    };
+
+    options_t options_;
+    motor_emulator_t motors_[EMULATOR_MOTORS];
+    /// Frame in progress
+    state_t state_;
+    unsigned char header_;
+    size_t length_;
+    std::vector<unsigned char> data_;
+    unsigned int frames_, errors_;
+
+    void decodeFrame(unsigned char header, const unsigned char* data, size_t length, std::vector<unsigned char>* reply);
+    /// Answer a message, the answer is appended to messages
+    void decodeMessage(unsigned char option, unsigned char type, unsigned char command,
+                       const unsigned char* payload, size_t length, std::vector<unsigned char>* messages);
+    void decodeSystem(unsigned char option, unsigned char command, const unsigned char* payload, size_t length,
+                      std::vector<unsigned char>* messages);
+    void decodeMotor(unsigned char option, unsigned char command, const unsigned char* payload, size_t length,
+                     std::vector<unsigned char>* messages);
+
+    /// Message with a payload of size bytes, size 0 for ACK and NACK
+    static void appendMessage(unsigned char option, unsigned char type, unsigned char command,
+                              const void* payload, size_t size, std::vector<unsigned char>* messages);
+    static void appendFrame(unsigned char header, const std::vector<unsigned char>& messages, std::vector<unsigned char>* reply);
+};
+
+#endif // BOARD_EMULATOR_H
@@ -0,0 +1,77 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+
+#ifndef EMULATOR_LOOP_H
+#define EMULATOR_LOOP_H
+
+#include "emulator/BoardEmulator.h"
+#include "emulator/PtyLink.h"
+
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <boost/thread/thread.hpp>
+
+/**
+ * Serve a PtyLink with a BoardEmulator.
+ *
+ * Every turn reads the bytes of the driver, moves the motors to the
+ * current time, answers and delivers the answers whose time is come.
+ * It runs in the caller thread with spinOnce() or on its own thread.
+ */
+class EmulatorLoop {
+public:
+    EmulatorLoop(BoardEmulator* board, PtyLink* link);
+    virtual ~EmulatorLoop();
+
+    /// Serve the link for at most a millisecond, false on error
+    bool spinOnce();
+
+    /// Serve the link on a new thread
+    void start();
+    void stop();
+
+private:
+    typedef boost::chrono::steady_clock clock_t;
+
+    BoardEmulator* board_;
+    PtyLink* link_;
+    std::vector<unsigned char> reply_;
+    unsigned char buffer_[256];
+    clock_t::time_point last_;
+    boost::thread thread_;
+    boost::atomic<bool> running_;
+
+    void run();
+};
+
+#endif // EMULATOR_LOOP_H
@@ -0,0 +1,130 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#ifndef PTY_LINK_H
+#define PTY_LINK_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+
+/**
+ * Pseudo-terminal seen by the driver as the serial port of the board.
+ *
+ * The frames written back are delayed by a fixed latency plus a random
+ * jitter, held until the line at the emulated baud rate had the time to
+ * send them, and can be corrupted a byte at a time.
+ */
+class PtyLink {
+public:
+    struct impairment_t {
+        /// Delay of every answer [ms]
+        double latency;
+        /// Random delay added to the latency, from 0 to jitter [ms]
+        double jitter;
+        /// Emulated baud rate, 0 without limit
+        unsigned int baud;
+        /// Probability of every byte sent to be corrupted
+        double corruption;
+        unsigned int seed;
+
+        impairment_t() : latency(0), jitter(0), baud(0), corruption(0), seed(1) {
+        }
+    };
+
+    PtyLink(const impairment_t& impairment = impairment_t());
+    virtual ~PtyLink();
+
+    /**
+     * Open the pseudo-terminal
+     * @param link if not empty, a symbolic link to the pseudo-terminal
+     * @return false on error
+     */
+    bool open(const std::string& link = "");
+    void close();
+
+    /// Name of the pseudo-terminal for the driver
+    std::string name() const {
+        return name_;
+    }
+
+    /**
+     * Read the bytes written by the driver
+     * @return bytes read, 0 on timeout, -1 on error
+     */
+    int read(unsigned char* buffer, size_t size, int timeout_ms);
+
+    /// Queue bytes for the driver
+    void write(const std::vector<unsigned char>& data);
+    /// Write the queued bytes whose time is come
+    void flush();
+    /// Time to the next queued bytes [ms], -1 with the queue empty
+    int nextWrite();
+
+    /// Bytes corrupted from the start
+    unsigned int corrupted() const {
+        return corrupted_;
+    }
+    /// Bytes written by the driver, can be read from any thread
+    unsigned long received() const {
+        return received_;
+    }
+    /// Bytes delivered to the driver, can be read from any thread
+    unsigned long sent() const {
+        return sent_;
+    }
+
+private:
+    typedef boost::chrono::steady_clock clock_t;
+
+    struct pending_t {
+        clock_t::time_point due;
+        std::vector<unsigned char> data;
+    };
+
+    impairment_t impairment_;
+    int master_, slave_;
+    std::string name_, link_;
+    std::deque<pending_t> queue_;
+    /// Last byte of the emulated line, answers are never reordered
+    clock_t::time_point line_free_;
+    unsigned int random_;
+    unsigned int corrupted_;
+    boost::atomic<unsigned long> received_, sent_;
+
+    double uniform();
+};
+
+#endif // PTY_LINK_H
@@ -4,7 +4,20 @@
 #include <ros/ros.h>
 #include <std_srvs/Empty.h>
 #include "serial_parser_packet/ParserPacket.h"
+#include "configurator/ConfigCache.h"
+#include "configurator/ShadowSync.h"
+#include "realtime/AllocationCounter.h"
+#include "realtime/LoopMonitor.h"
+#include "transport/PacketList.h"
+#include "transport/PacketWindow.h"
+#include "transport/SerialExecutor.h"
+#include "transport/StartupPlanner.h"
+#include "transport/TransactionPolicy.h"
 #include "hardware_interface/robot_hw.h"
+#include <diagnostic_updater/diagnostic_updater.h>
+
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
 
 /**
  * Thrown if timeout occurs
@@ -18,12 +31,32 @@ public:
 
 class ORBHardware : public hardware_interface::RobotHW {
 public:
+    /// Phases of the control loop
+    enum loop_phase_t {
+        LOOP_READ,
+        LOOP_UPDATE,
+        LOOP_WRITE,
+        LOOP_PHASES
+    };
+
     ORBHardware(const ros::NodeHandle& nh, const ros::NodeHandle& private_nh, ParserPacket* serial);
 
-    void updateDiagnostics();
+    virtual void updateDiagnostics();
 
     void reportLoopDuration(const ros::Duration &duration);
 
+    /// Time spent by this control tick, lock-free from the control thread
+    void reportCycleDuration(const ros::Duration &duration);
+
+    /**
+     * Traffic of every control tick, with the answers, and warn if it does not
+     * fit in the part of the control period for the serial transactions
+     */
+    void setTickTraffic(double sent, double received);
+
+    /// Allocations of a phase in this control tick, lock-free from the control thread
+    void reportAllocations(loop_phase_t phase, const AllocationCounter::sample_t& sample);
+
     virtual ~ORBHardware();
 
     void loadParameter();
@@ -31,16 +64,16 @@ public:
     std::string getNameBoard();
     std::string getTypeBoard();
 
-    void addVectorPacketRequest(const boost::function<void (std::vector<packet_information_t>*) >& callback);
+    void addVectorPacketRequest(const boost::function<void (PacketList*) >& callback);
 
-    template <class T> void addVectorPacketRequest(void(T::*fp)(std::vector<packet_information_t>*), T* obj) {
+    template <class T> void addVectorPacketRequest(void(T::*fp)(PacketList*), T* obj) {
         addVectorPacketRequest(boost::bind(fp, obj, _1));
     }
     void clearVectorPacketRequest();
 
-    void addParameterPacketRequest(const boost::function<void (std::vector<packet_information_t>*) >& callback);
+    void addParameterPacketRequest(const boost::function<void (StartupPlanner*) >& callback);
 
-    template <class T> void addParameterPacketRequest(void(T::*fp)(std::vector<packet_information_t>*), T* obj) {
+    template <class T> void addParameterPacketRequest(void(T::*fp)(StartupPlanner*), T* obj) {
         addParameterPacketRequest(boost::bind(fp, obj, _1));
     }
     void clearParameterPacketRequest();
@@ -53,17 +86,38 @@ public:
     void clearTimerEvent();
 
 protected:
+    /**
+     * Start the executor and read the information of the board. Called by
+     * the most derived constructor, so that the answers dispatched from the
+     * executor thread never reach a partially built object
+     */
+    void start();
+
     //Initialization object
     ros::NodeHandle nh_; //NameSpace for bridge controller
     ros::NodeHandle private_nh_; //Private NameSpace for bridge controller
     ParserPacket* serial_; //Serial object to comunicate with PIC device
+    PacketWindow* window_; //Pipelined requests, NULL in stop-and-wait mode
+    TransactionPolicy policy_; //Retries and timeout of every transaction
+    SerialExecutor executor_; //Thread that owns the serial port
+    ConfigCache cache_; //Board configuration from the last launch
+    ShadowSync shadow_; //Board configuration confirmed in this launch
+    diagnostic_updater::Updater diagnostic_; //Status of the driver and of the board
+    LoopMonitor loop_; //Period and duration of the control ticks
+    double measure_max_delay_; //Oldest measure acceptable in a control tick [s]
+    double serial_rate_; //Baud rate of the serial port
     std::string name_board_, version_, name_author_, compiled_, type_board_;
+
+    /// Called on the serial thread for every NACK received, without its hashmap
+    virtual void errorPacket(const unsigned char& command, const message_abstract_u* packet);
 private:
 
-    typedef boost::function<void (std::vector<packet_information_t>*) > callback_add_packet_t;
+    typedef boost::function<void (PacketList*) > callback_add_packet_t;
     typedef boost::function<void (const ros::TimerEvent&) > callback_timer_event_t;
-    typedef boost::function<bool (const ros::TimerEvent&, std::vector<packet_information_t>*) > callback_add_event_t;
-    callback_add_packet_t callback_add_packet, callback_add_parameter;
+    typedef boost::function<bool (const ros::TimerEvent&, PacketList*) > callback_add_event_t;
+    typedef boost::function<void (StartupPlanner*) > callback_add_parameter_t;
+    callback_add_packet_t callback_add_packet;
+    callback_add_parameter_t callback_add_parameter;
     callback_add_event_t callback_alive_event;
     callback_timer_event_t callback_timer_event;
 
@@ -76,10 +130,51 @@ private:
     bool init_number_process;
     std::map<std::string, int> map_error_serial;
 
-    std::vector<packet_information_t> updatePacket();
+    /// Allocations of a phase of the control loop since the last diagnostic
+    struct allocation_stats_t {
+        boost::atomic<unsigned long> ticks, count, bytes, max;
+
+        allocation_stats_t() : ticks(0), count(0), bytes(0), max(0) {
+        }
+    } allocations_[LOOP_PHASES];
+
+    void allocationDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+
+    /// NACKs received, written by the serial thread
+    boost::atomic<unsigned long> nacks_;
+    /// Part of the control period for the serial transactions
+    double control_ratio_;
+    /// Bytes expected on the line every control tick
+    double tick_sent_, tick_received_;
+    /// Serial link at the last diagnostic
+    struct link_stats_t {
+        boost::chrono::steady_clock::time_point time;
+        unsigned long sent, received, errors, sent_frames, received_frames;
+        /// Bytes of every command
+        unsigned long command_sent[EXECUTOR_COMMANDS], command_received[EXECUTOR_COMMANDS];
+
+        link_stats_t() : time(boost::chrono::steady_clock::now()), sent(0), received(0), errors(0),
+            sent_frames(0), received_frames(0) {
+            for (unsigned int i = 0; i < EXECUTOR_COMMANDS; ++i)
+                command_sent[i] = command_received[i] = 0;
+        }
+    } link_;
+
+    /// Frequency, jitter, overruns and duration of the control loop, age of its measures
+    void loopDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+    /// Windows with measures too old or from the future
+    unsigned long stamp_late_, stamp_early_;
+    /// Traffic and errors of the serial link
+    void linkDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+
+    /// Timeouts at the last diagnostic, a new one is a warning
+    unsigned long serial_timeouts_;
+    /// Round trip, retries and timeouts of every command
+    void latencyDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+
+    void updatePacket(PacketList* list_packet);
 
     float getTimeProcess(float process_time);
-    void errorPacket(const unsigned char& command, const message_abstract_u* packet);
     void defaultPacket(const unsigned char& command, const message_abstract_u* packet);
 
     std::string getNameError(int number);
@@ -9,6 +9,13 @@
 #define	UNAVHARDWARE_H
 
 #include "ORBHardware.h"
+#include "transport/FrameTemplate.h"
+#include "realtime/TripleBuffer.h"
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <orbus_msgs/UnavStatus.h>
 
 #include <urdf/model.h>
 
@@ -24,6 +31,8 @@
 #include "configurator/MotorEmergencyConfigurator.h"
 
 #define NUM_MOTORS 2
+/// Groups of the status polled in round robin: the diagnostic of every motor, the state of all motors
+#define STATUS_GROUPS (NUM_MOTORS + 1)
 
 class UNAVHardware : public ORBHardware {
 public:
@@ -33,13 +42,108 @@ public:
     void updateJointsFromHardware();
     void writeCommandsToHardware(ros::Duration period);
 
+    /// Diagnostics of the driver and status of the board
+    void updateDiagnostics();
+
+    /**
+     * Start the measure stream, if enabled, on the queue of the driver loops.
+     * The board has no periodic measures: the stream is a host timer that
+     * requests them at its own rate, decoupled from the control loop.
+     */
+    void startStream(ros::CallbackQueue* queue);
+
+    /// Convert a velocity from rad/s to mrad/s, saturated on 16 bit
+    static motor_control_t velocityToBoard(double velocity);
+
 private:
     /// URDF information about robot
     boost::shared_ptr<urdf::ModelInterface> urdf_;
-    /// Decode a motor command
-    motor_command_map_t motor_command_;
-    /// List to send messages to serial
-    std::vector<packet_information_t> list_send_;
+    /**
+    * Measure of all motors, published complete by the thread that decodes them
+    */
+    struct joint_measure_t
+    {
+      double position[NUM_MOTORS];
+      double velocity[NUM_MOTORS];
+      double effort[NUM_MOTORS];
+      /// steady_clock time of the last measure [ns]
+      int64_t stamp;
+
+      joint_measure_t() : stamp(0) {
+          for(int i = 0; i < NUM_MOTORS; ++i) {
+              position[i] = velocity[i] = effort[i] = 0;
+          }
+      }
+    };
+    /**
+     * Answers are decoded on the executor thread, from parsing, and on the
+     * receive thread of ParserPacket, from the asynchronous frames: the
+     * staging of measures and status, and the writes of their buffers, hold
+     * this lock. The control loop never takes it.
+     */
+    boost::mutex rx_mutex_;
+    /// Measure in progress, with rx_mutex_
+    joint_measure_t measure_rx_;
+    /// Motors in measure_rx_ since the last publish
+    unsigned int measure_mask_;
+    /// Last complete measure for the control loop
+    TripleBuffer<joint_measure_t> measure_buffer_;
+    /// Joint constraints, sent with the other startup messages
+    PacketList list_limits_;
+    /// Measure requests and velocity references sent every control tick
+    PacketList list_read_, list_write_;
+    FrameTemplate read_frame_, write_frame_;
+
+    /// Rate of the measure stream, 0 to request the measures every control tick
+    double stream_rate_;
+    /// Timer of the measure stream
+    ros::WallTimer stream_timer_;
+    /// Request the measures in the same frame of the velocity references
+    bool combined_;
+    /// The last write requested the measures for the next tick
+    bool measure_requested_;
+    /// Send the velocity references without waiting the answer
+    bool async_commands_;
+
+    /**
+    * Status of the board, published complete by the thread that decodes it
+    */
+    struct board_status_t
+    {
+      /// [A], [V] and [C]
+      double current[NUM_MOTORS];
+      double voltage[NUM_MOTORS];
+      double temperature[NUM_MOTORS];
+      motor_state_t state[NUM_MOTORS];
+
+      board_status_t() {
+          for(int i = 0; i < NUM_MOTORS; ++i) {
+              current[i] = voltage[i] = temperature[i] = 0;
+              state[i] = STATE_CONTROL_DISABLE;
+          }
+      }
+    };
+    /// Status in progress, with rx_mutex_
+    board_status_t status_rx_;
+    /// Last status for the diagnostic thread
+    TripleBuffer<board_status_t> status_buffer_;
+    /// Request of every group and time on the line of request and answer [us]
+    FrameTemplate status_frames_[STATUS_GROUPS];
+    long status_airtime_us_[STATUS_GROUPS];
+    /// Next group and time of the next poll, owned by the control thread
+    unsigned int status_group_;
+    boost::chrono::steady_clock::time_point status_next_;
+    /// Time between two polls [s], 0 without polling
+    double status_interval_;
+    /// A poll waits its answer
+    boost::atomic<bool> status_pending_;
+    SerialExecutor::callback_t status_callback_;
+    /// Status message, filled on the diagnostic thread
+    ros::Publisher pub_status_;
+    orbus_msgs::UnavStatus status_msg_;
+    /// Control ticks and time at the last publish
+    unsigned long status_cycles_;
+    boost::chrono::steady_clock::time_point status_time_;
 
     /// ROS Control interfaces
     hardware_interface::JointStateInterface joint_state_interface_;
@@ -53,8 +157,28 @@ private:
     /// Setup all limits
     void setupLimits(hardware_interface::JointHandle joint_handle, ros::V_string joint_names, int i);
 
+    /// Encode the frames sent every control tick
+    void buildFrames();
+    /// Add the measure requests of all motors
+    void addMeasureRequest(PacketList* list_send);
+    /// Send the measure requests of this tick
+    void requestMeasures();
+    void streamMeasure(const ros::WallTimerEvent&);
+
+    /// Send the velocity references of this tick
+    void sendReferences(ros::Duration period);
+    /// Encode the requests of every status group
+    void buildStatusFrames();
+    /// Request the next status group, only in the time left in this tick
+    void pollStatus();
+    void statusPolled(bool, const PacketList&);
+    void publishStatus();
+    /// Answers of the velocity references sent without waiting
+    void commandDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status);
+
     void motorPacket(const unsigned char& command, const message_abstract_u* packet);
-    void addParameter(std::vector<packet_information_t>* list_send);
+    void errorPacket(const unsigned char& command, const message_abstract_u* packet);
+    void addParameter(StartupPlanner* planner);
 
     /**
     * Joint structure that is hooked to ros_control's InterfaceManager, to allow control via diff_drive_controller
@@ -73,7 +197,17 @@ private:
       double effort;
       double velocity_command;
 
-      Joint() : position(0), velocity(0), effort(0), velocity_command(0) { }
+      // Velocity references sent without waiting, updated from the serial thread
+      boost::atomic<unsigned int> command_sent, command_ack, command_nack, command_lost;
+      boost::atomic<bool> command_pending;
+      // Last reference acknowledged by the board, steady clock [ns]
+      boost::atomic<long long> command_time;
+      // NACK and lost references at the last diagnostic
+      unsigned int reported_nack, reported_lost;
+
+      Joint() : position(0), velocity(0), effort(0), velocity_command(0),
+          command_sent(0), command_ack(0), command_nack(0), command_lost(0), command_pending(false),
+          command_time(0), reported_nack(0), reported_lost(0) { }
     } joints_[NUM_MOTORS];
 
 };
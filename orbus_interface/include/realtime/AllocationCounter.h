@@ -0,0 +1,70 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <stddef.h>
+
+/**
+ * Allocations of the calling thread.
+ *
+ * Built with ORBUS_COUNT_ALLOCATIONS, malloc, calloc and realloc count
+ * every allocation and its size for the thread that makes it, and so does
+ * operator new, that calls malloc. Without glibc only operator new is
+ * counted. Without ORBUS_COUNT_ALLOCATIONS, nothing is counted and the
+ * samples are always zero.
+ */
+class AllocationCounter {
+public:
+    /// Allocations and bytes allocated by the thread from its start
+    struct sample_t {
+        unsigned long count;
+        unsigned long bytes;
+
+        sample_t() : count(0), bytes(0) {
+        }
+
+        sample_t operator-(const sample_t& other) const {
+            sample_t difference;
+            difference.count = count - other.count;
+            difference.bytes = bytes - other.bytes;
+            return difference;
+        }
+    };
+
+    /// true if this build counts the allocations
+    static bool enabled();
+
+    static sample_t sample();
+};
+
+#endif // ALLOCATION_COUNTER_H
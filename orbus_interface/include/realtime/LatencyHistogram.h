@@ -0,0 +1,115 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+/**
+ * Histogram of latencies in microseconds, in a fixed memory.
+ *
+ * As in HdrHistogram, the values up to 32 us have a bucket each, and
+ * every power of two above is split in 16 buckets: a percentile is known
+ * within 1/16 of its value, up to about 16 s. One thread records, any
+ * other thread reads, without locks.
+ */
+class LatencyHistogram : boost::noncopyable {
+public:
+    /// Buckets up to 2^24 us, the longer values are counted in the last one
+    static const unsigned int BUCKETS = 32 + 19 * 16;
+
+    LatencyHistogram() : count_(0), max_(0) {
+        for (unsigned int i = 0; i < BUCKETS; ++i)
+            buckets_[i].store(0, boost::memory_order_relaxed);
+    }
+
+    /// Writer thread only
+    void record(unsigned long value) {
+        buckets_[bucket(value)].fetch_add(1, boost::memory_order_relaxed);
+        if (value > max_.load(boost::memory_order_relaxed))
+            max_.store(value, boost::memory_order_relaxed);
+        count_.fetch_add(1, boost::memory_order_release);
+    }
+
+    unsigned long count() const {
+        return count_.load(boost::memory_order_acquire);
+    }
+
+    unsigned long max() const {
+        return max_.load(boost::memory_order_relaxed);
+    }
+
+    /// Highest value of the bucket with the percentile, 0 without values
+    unsigned long percentile(double percentile) const {
+        unsigned long total = count();
+        if (total == 0)
+            return 0;
+        unsigned long rank = (unsigned long) (percentile / 100.0 * total);
+        if (rank >= total)
+            rank = total - 1;
+        unsigned long seen = 0;
+        for (unsigned int i = 0; i < BUCKETS; ++i) {
+            seen += buckets_[i].load(boost::memory_order_relaxed);
+            if (seen > rank)
+                return (i < BUCKETS - 1) ? std::min(highest(i), max()) : max();
+        }
+        return max();
+    }
+
+private:
+    boost::atomic<unsigned long> buckets_[BUCKETS];
+    boost::atomic<unsigned long> count_, max_;
+
+    static unsigned int bucket(unsigned long value) {
+        if (value < 32)
+            return value;
+        unsigned int shift = 0;
+        /// Keep the five most significant bits
+        while ((value >> shift) >= 32)
+            shift++;
+        unsigned int index = shift * 16 + (value >> shift);
+        return (index < BUCKETS) ? index : BUCKETS - 1;
+    }
+
+    static unsigned long highest(unsigned int index) {
+        if (index < 32)
+            return index;
+        unsigned int shift = (index - 16) / 16;
+        unsigned long lowest = (unsigned long) (index - shift * 16) << shift;
+        return lowest + (1UL << shift) - 1;
+    }
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,108 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#ifndef LOOP_MONITOR_H
+#define LOOP_MONITOR_H
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+/**
+ * Timing of a periodic loop.
+ *
+ * The loop thread adds the period and the duration of every cycle, and the
+ * delay of the data it used, with atomic counters, without locks. The diagnostic thread collects the
+ * statistics of the cycles since its last call and starts a new window.
+ */
+class LoopMonitor : boost::noncopyable {
+public:
+    /// Cycles of a window
+    struct stats_t {
+        /// Length of the window [s]
+        double window;
+        unsigned long cycles;
+        /// Cycles started more than half a period late
+        unsigned long overruns;
+        /// Difference between the period and the target period [us]
+        double jitter_mean, jitter_max;
+        /// Time spent by a cycle [us]
+        double cycle_mean, cycle_max;
+        /// Time from the last cycle to the end of the window [s], negative without cycles
+        double since_last;
+        /// Cycles that reported the delay of their data
+        unsigned long stamps;
+        /// Earliest and latest delay of the data, valid with stamps > 0 [s]
+        double delay_min, delay_max;
+    };
+
+    LoopMonitor();
+
+    /// Target frequency [Hz]
+    void setFrequency(double frequency);
+    double frequency() const {
+        return frequency_;
+    }
+
+    /// Loop thread: time from the start of the previous cycle [ns]
+    void period(long long period);
+    /// Loop thread: time spent by this cycle [ns]
+    void cycle(long long duration);
+    /// Loop thread: age of the data used by this cycle [ns]
+    void stamp(long long delay);
+
+    /// Cycles from the start
+    unsigned long total() const {
+        return total_;
+    }
+
+    /// Diagnostic thread: statistics of the cycles since the last call
+    stats_t collect();
+
+private:
+    double frequency_;
+    long long period_ns_;
+    boost::atomic<unsigned long> total_, cycles_, overruns_;
+    /// Sums and maximums in microseconds
+    boost::atomic<unsigned long> jitter_sum_, jitter_max_, cycle_sum_, cycle_max_, durations_;
+    /// Monotonic time of the last cycle [ns]
+    boost::atomic<long long> last_;
+    /// Delays of the data [ns]
+    boost::atomic<unsigned long> stamps_;
+    boost::atomic<long long> delay_min_, delay_max_;
+    /// Start of the window, owned by the diagnostic thread
+    long long window_start_;
+
+    static void updateMax(boost::atomic<unsigned long>& max, unsigned long value);
+    static void updateMin(boost::atomic<long long>& min, long long value);
+    static void updateMax(boost::atomic<long long>& max, long long value);
+};
+
+#endif // LOOP_MONITOR_H
@@ -0,0 +1,100 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#ifndef REALTIME_LOOP_H
+#define REALTIME_LOOP_H
+
+#include <time.h>
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+
+/**
+ * Periodic loop on a dedicated thread.
+ *
+ * The thread sleeps to absolute deadlines on the monotonic clock, so the
+ * period does not drift with the execution time of the callback. It can
+ * run with SCHED_FIFO priority, pinned to a CPU, with the memory of the
+ * process locked and its stack prefaulted.
+ */
+class RealtimeLoop {
+public:
+    /// What to do when a cycle ends after the next deadline
+    enum overrun_t {
+        /// Skip the deadlines already missed
+        OVERRUN_SKIP,
+        /// Run the missed cycles back to back
+        OVERRUN_CATCHUP
+    };
+
+    struct options_t {
+        /// SCHED_FIFO priority, 0 keeps the default scheduler
+        int priority;
+        /// CPU of the thread, -1 for any CPU
+        int cpu;
+        /// Lock all the memory of the process with mlockall
+        bool lock_memory;
+        /// Bytes of stack touched before the first cycle
+        size_t stack_prefault;
+        overrun_t overrun;
+
+        options_t() : priority(0), cpu(-1), lock_memory(true), stack_prefault(64 * 1024), overrun(OVERRUN_SKIP) {
+        }
+    };
+
+    RealtimeLoop(double frequency, const boost::function<void ()>& callback, const options_t& options = options_t());
+    virtual ~RealtimeLoop();
+
+    void start();
+    void stop();
+
+    /// Cycles ended after the next deadline
+    unsigned int overruns() const {
+        return overruns_;
+    }
+
+    static overrun_t overrunFromString(const std::string& name);
+
+private:
+    long period_ns_;
+    boost::function<void ()> callback_;
+    options_t options_;
+    boost::thread thread_;
+    boost::atomic<bool> running_;
+    boost::atomic<unsigned int> overruns_;
+
+    void run();
+    void setupThread();
+};
+
+#endif // REALTIME_LOOP_H
@@ -0,0 +1,92 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <stddef.h>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+/**
+ * Spans of time recorded by every thread, dumped as a Chrome trace.
+ *
+ * Every thread writes in a ring of its own, without locks or allocations,
+ * and the oldest spans are overwritten. The ring is allocated by thread(),
+ * called by every traced thread before its first span: the spans of a
+ * thread without ring are dropped. dump() copies the rings from any
+ * thread and writes the JSON read by chrome://tracing and Perfetto.
+ */
+class Tracer {
+public:
+    /// Start or stop the recording, events is the size of the ring of a new thread
+    static void enable(bool enable, size_t events = 8192);
+    static bool enabled();
+
+    /// Allocate the ring of the calling thread while recording, only the first name is kept
+    static void thread(const char* name);
+
+    /// Nanoseconds on the monotonic clock
+    static long long now();
+
+    /**
+     * Record a span of the calling thread
+     * @param name and category must be string literals, only the pointer is saved
+     */
+    static void record(const char* name, const char* category, long long begin, long long end);
+
+    /// Write the spans of every thread, false if the file cannot be written
+    static bool dump(const std::string& path);
+};
+
+/**
+ * Span from the construction to the end of the scope
+ */
+class TraceScope : boost::noncopyable {
+public:
+
+    TraceScope(const char* name, const char* category)
+    : name_(name), category_(category), begin_(Tracer::enabled() ? Tracer::now() : 0) {
+    }
+
+    ~TraceScope() {
+        if (begin_ != 0)
+            Tracer::record(name_, category_, begin_, Tracer::now());
+    }
+
+private:
+    const char* name_;
+    const char* category_;
+    long long begin_;
+};
+
+#endif // TRACER_H
@@ -0,0 +1,80 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+/**
+ * Lock-free hand-off of the last value from one writer to one reader.
+ * Several threads can write only one at a time, under a lock of theirs.
+ *
+ * The writer and the reader own a buffer each, the third one is shared
+ * and swapped atomically. Neither side ever waits, the reader always
+ * gets a complete value and values not read in time are overwritten.
+ */
+template <class T> class TripleBuffer : boost::noncopyable {
+public:
+    TripleBuffer() : write_(0), read_(1), middle_(2) {
+    }
+
+    /// Writer thread: publish a new value
+    void write(const T& value) {
+        buffer_[write_] = value;
+        unsigned int previous = middle_.exchange(write_ | NEW_DATA, boost::memory_order_acq_rel);
+        write_ = previous & INDEX_MASK;
+    }
+
+    /// Reader thread: the last value published, valid until the next read
+    const T& read() {
+        if (middle_.load(boost::memory_order_relaxed) & NEW_DATA) {
+            unsigned int previous = middle_.exchange(read_, boost::memory_order_acq_rel);
+            read_ = previous & INDEX_MASK;
+        }
+        return buffer_[read_];
+    }
+
+private:
+    static const unsigned int INDEX_MASK = 0x3;
+    static const unsigned int NEW_DATA = 0x4;
+
+    T buffer_[3];
+    /// Buffer owned by the writer
+    unsigned int write_;
+    /// Buffer owned by the reader
+    unsigned int read_;
+    /// Shared buffer, with NEW_DATA if not read yet
+    boost::atomic<unsigned int> middle_;
+};
+
+#endif // TRIPLE_BUFFER_H
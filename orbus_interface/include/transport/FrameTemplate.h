@@ -0,0 +1,82 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#ifndef FRAME_TEMPLATE_H
+#define FRAME_TEMPLATE_H
+
+#include "serial_parser_packet/ParserPacket.h"
+#include "transport/PacketList.h"
+
+/**
+ * Frame encoded once and sent many times.
+ *
+ * build() encodes a list of messages with ParserPacket::encoder and finds
+ * where the payload of every message is stored in the frame, following
+ * the message lengths. patch() overwrites the payload in place, so a
+ * recurring frame is refreshed without allocations and without encoding
+ * the whole list again. Header, length and checksum are not part of the
+ * template: PacketSerial adds them when the frame is written.
+ */
+class FrameTemplate {
+public:
+    FrameTemplate();
+
+    /// Encode the frame, the list can mix requests and data messages
+    void build(ParserPacket* serial, const std::vector<packet_information_t>& list_send);
+
+    void build(ParserPacket* serial, const PacketList& list_send) {
+        build(serial, list_send.vector());
+    }
+
+    /**
+     * Overwrite length bytes of the payload of the message number index
+     * @return false if the message has no payload in the frame
+     */
+    bool patch(unsigned int index, const void* data, size_t length);
+
+    template <class T> bool patch(unsigned int index, const T& value) {
+        return patch(index, &value, sizeof(T));
+    }
+
+    const packet_t& packet() const {
+        return packet_;
+    }
+    bool empty() const {
+        return offset_.empty();
+    }
+
+private:
+    packet_t packet_;
+    /// Position of the payload of every message in packet_.buffer, -1 without payload
+    std::vector<int> offset_;
+};
+
+#endif // FRAME_TEMPLATE_H
@@ -0,0 +1,80 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#ifndef ORBUS_FRAME_H
+#define ORBUS_FRAME_H
+
+#include "serial_parser_packet/ParserPacket.h"
+
+/**
+ * Layout of an ORBus frame, as ParserPacket encodes it:
+ *
+ *   header | length | message ... message | checksum
+ *
+ * The length counts the messages, the checksum is the sum of the message
+ * bytes modulo 256. Every message is
+ *
+ *   length | option | hashmap | command | payload
+ *
+ * with the length of the whole message. Every constant can be defined at
+ * build time if the firmware uses another layout.
+ */
+
+#ifndef ORBUS_HEADER_SYNC
+#define ORBUS_HEADER_SYNC HEADER_SYNC
+#endif
+
+#ifndef ORBUS_HEADER_ASYNC
+#define ORBUS_HEADER_ASYNC HEADER_ASYNC
+#endif
+
+/// Bytes of the frame before the messages: header and length
+#ifndef ORBUS_FRAME_HEAD
+#define ORBUS_FRAME_HEAD 2
+#endif
+
+/// Bytes of the frame after the messages: checksum
+#ifndef ORBUS_FRAME_TAIL
+#define ORBUS_FRAME_TAIL 1
+#endif
+
+/// Bytes of a message before the payload: length, option, hashmap and command
+#ifndef ORBUS_MESSAGE_HEAD
+#define ORBUS_MESSAGE_HEAD LNG_HEAD_INFORMATION_PACKET
+#endif
+
+/// Longest list of messages in a frame
+#ifndef ORBUS_MAX_DATA
+#define ORBUS_MAX_DATA (sizeof(((packet_t*) NULL)->buffer))
+#endif
+
+#endif // ORBUS_FRAME_H
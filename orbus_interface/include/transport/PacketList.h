@@ -0,0 +1,144 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#ifndef PACKET_LIST_H
+#define PACKET_LIST_H
+
+#include "transport/ORBusFrame.h"
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+/// Most messages in a frame, all without payload
+#define PACKET_LIST_SIZE (ORBUS_MAX_DATA / ORBUS_MESSAGE_HEAD)
+
+/**
+ * List of the messages of a frame, stored inside the object.
+ *
+ * It never allocates, so it can be filled and emptied every control tick.
+ * The messages are large, the list is never copied implicitly: swap()
+ * moves a list and assign() copies it on purpose.
+ */
+class PacketList : boost::noncopyable {
+public:
+    typedef packet_information_t* iterator;
+    typedef const packet_information_t* const_iterator;
+
+    PacketList() : size_(0) {
+    }
+
+    /// false with the list full, the message is dropped
+    bool push_back(const packet_information_t& packet) {
+        if (size_ == PACKET_LIST_SIZE)
+            return false;
+        packets_[size_++] = packet;
+        return true;
+    }
+
+    void clear() {
+        size_ = 0;
+    }
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+    static size_t capacity() {
+        return PACKET_LIST_SIZE;
+    }
+
+    packet_information_t& operator[](size_t index) {
+        return packets_[index];
+    }
+    const packet_information_t& operator[](size_t index) const {
+        return packets_[index];
+    }
+
+    iterator begin() {
+        return packets_;
+    }
+    iterator end() {
+        return packets_ + size_;
+    }
+    const_iterator begin() const {
+        return packets_;
+    }
+    const_iterator end() const {
+        return packets_ + size_;
+    }
+
+    /// Exchange the messages of the two lists
+    void swap(PacketList& other) {
+        size_t size = (size_ > other.size_) ? size_ : other.size_;
+        for (size_t i = 0; i < size; ++i) {
+            packet_information_t packet = packets_[i];
+            packets_[i] = other.packets_[i];
+            other.packets_[i] = packet;
+        }
+        size_t other_size = other.size_;
+        other.size_ = size_;
+        size_ = other_size;
+    }
+
+    /// Copy the messages of another list
+    void assign(const PacketList& other) {
+        size_ = other.size_;
+        for (size_t i = 0; i < size_; ++i)
+            packets_[i] = other.packets_[i];
+    }
+
+    /**
+     * Copy the messages decoded by ParserPacket
+     * @return messages dropped with the list full
+     */
+    size_t assign(const std::vector<packet_information_t>& list) {
+        clear();
+        for (std::vector<packet_information_t>::const_iterator it = list.begin(); it != list.end(); ++it) {
+            if (!push_back(*it))
+                return list.end() - it;
+        }
+        return 0;
+    }
+
+    /// The messages for ParserPacket::encoder, it allocates: only for the frames built once
+    std::vector<packet_information_t> vector() const {
+        return std::vector<packet_information_t>(begin(), end());
+    }
+
+private:
+    packet_information_t packets_[PACKET_LIST_SIZE];
+    size_t size_;
+};
+
+#endif // PACKET_LIST_H
@@ -0,0 +1,107 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#ifndef PACKET_WINDOW_H
+#define PACKET_WINDOW_H
+
+#include "serial_parser_packet/ParserPacket.h"
+#include "transport/SerialExecutor.h"
+
+#include <deque>
+#include <boost/chrono.hpp>
+#include <boost/thread/mutex.hpp>
+
+/**
+ * Sliding window of ORBus requests on the asynchronous channel.
+ *
+ * Every message is sent in its own frame on the asynchronous channel of
+ * the SerialExecutor, up to
+ * size() messages can wait for an answer at the same time and the others
+ * are queued. Replies are matched with the oldest request in flight with
+ * the same hashmap and command. The owner forwards every packet received
+ * from ParserPacket with receive(), and calls update() to retransmit or
+ * drop the requests without answer. NACKs are not matched: ParserPacket
+ * reports them without hashmap, so a refused request ends by timeout.
+ */
+class PacketWindow {
+public:
+    /// Called when a request is closed: true with the reply, false and NULL on timeout
+    typedef boost::function<void (bool, const message_abstract_u*) > callback_complete_t;
+
+    PacketWindow(ParserPacket* serial, SerialExecutor* executor, unsigned int size);
+
+    /**
+     * Add a request to the window.
+     * @return false if the queue is full and the request is dropped
+     */
+    bool submit(const packet_information_t& packet, const callback_complete_t& callback = callback_complete_t(),
+                unsigned int repeat = 3, boost::posix_time::millisec timeout = boost::posix_time::millisec(200));
+
+    /// Close the oldest request in flight for this hashmap and command
+    void receive(unsigned char type, unsigned char command, const message_abstract_u* packet);
+
+    /// Retransmit or drop requests without answer and fill the free slots
+    void update();
+
+    /// Drop all requests, the callbacks are not called
+    void clear();
+
+    unsigned int size() const {
+        return size_;
+    }
+    unsigned int inFlight();
+
+private:
+    typedef boost::chrono::steady_clock clock_t;
+
+    struct request_t {
+        packet_information_t packet;
+        callback_complete_t callback;
+        unsigned int repeat;
+        clock_t::duration timeout;
+        clock_t::time_point deadline;
+    };
+
+    ParserPacket* serial_;
+    SerialExecutor* executor_;
+    unsigned int size_;
+    boost::mutex mutex_;
+    /// Requests waiting for an answer, the oldest in front
+    std::deque<request_t> flight_;
+    /// Requests waiting for a free slot
+    std::deque<request_t> queue_;
+
+    /// Must be called with mutex_ locked
+    void transmit(request_t& request);
+    void fill();
+};
+
+#endif // PACKET_WINDOW_H
@@ -0,0 +1,220 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#ifndef SERIAL_EXECUTOR_H
+#define SERIAL_EXECUTOR_H
+
+#include "serial_parser_packet/ParserPacket.h"
+#include "realtime/LatencyHistogram.h"
+#include "transport/PacketList.h"
+#include "transport/TransactionPolicy.h"
+
+#include <boost/atomic.hpp>
+#include <boost/interprocess/sync/interprocess_semaphore.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <boost/thread/thread.hpp>
+
+/// Commands with their own statistics, the others are not counted
+#define EXECUTOR_COMMANDS 32
+
+/**
+ * Thrown if the policy leaves no time for the transaction
+ */
+class transaction_dropped : public std::runtime_error {
+public:
+
+    transaction_dropped(const std::string& arg) : runtime_error(arg) {
+    }
+};
+
+/**
+ * The only thread that writes on the serial port.
+ *
+ * Every other thread submits its transactions on a lock-free queue and
+ * gets the answer on a callback, or waits for it with execute(). Control
+ * traffic is always served before configuration traffic, and background
+ * traffic only when both queues are empty. Retries,
+ * timeout and deadline of every transaction come from the TransactionPolicy,
+ * checked when the transaction is submitted: a transaction still queued
+ * after its deadline is dropped, and every attempt of a configuration
+ * transaction is queued again after the control traffic.
+ *
+ * For every command sent, the executor records the round trip of the
+ * transactions with it, its retries and its timeouts.
+ */
+class SerialExecutor {
+public:
+    /// Called on the executor thread: true with the messages received, false on error
+    typedef boost::function<void (bool, const PacketList&) > callback_t;
+
+    SerialExecutor(ParserPacket* serial, TransactionPolicy* policy);
+    virtual ~SerialExecutor();
+
+    void start();
+    void stop();
+
+    /**
+     * Queue a transaction, the answer is dispatched by ParserPacket::parsing
+     * @return false if the policy drops the transaction, once stopped or with every transaction in use
+     */
+    bool submit(TransactionPolicy::traffic_t traffic, const packet_t& packet, const callback_t& callback = callback_t());
+
+    /**
+     * Queue a frame on the asynchronous channel, without answer
+     * @return false once stopped or with every transaction in use
+     */
+    bool post(TransactionPolicy::traffic_t traffic, const packet_t& packet);
+
+    /**
+     * Run a transaction and wait for the answer, at most until its deadline
+     * @param receive if not NULL, the messages received
+     * @throw transaction_dropped if the policy drops it, std::runtime_error without answer
+     */
+    void execute(TransactionPolicy::traffic_t traffic, const packet_t& packet, PacketList* receive = NULL);
+
+    TransactionPolicy* policy() {
+        return policy_;
+    }
+
+    /// Transactions with a command, written by the executor thread and read from any thread
+    struct command_stats_t {
+        unsigned char hashmap;
+        /// For HASHMAP_MOTOR without the number of the motor
+        unsigned char command;
+        /// Round trip of the attempt answered [us]
+        LatencyHistogram latency;
+        /// Attempts after the first one, and attempts without answer
+        boost::atomic<unsigned long> retries, timeouts;
+        /// Bytes of its messages sent, with the retries, and received
+        boost::atomic<unsigned long> sent, received;
+
+        command_stats_t() : hashmap(0), command(0), retries(0), timeouts(0), sent(0), received(0) {
+        }
+    };
+
+    /// Bytes of the frames sent, with the retries
+    unsigned long sent() const {
+        return sent_.load(boost::memory_order_relaxed);
+    }
+    /// Bytes of the answers received
+    unsigned long received() const {
+        return received_.load(boost::memory_order_relaxed);
+    }
+    /// Frames sent, with the retries, and answers received
+    unsigned long sentFrames() const {
+        return sent_frames_.load(boost::memory_order_relaxed);
+    }
+    unsigned long receivedFrames() const {
+        return received_frames_.load(boost::memory_order_relaxed);
+    }
+
+    /// Transactions refused with every transaction of the pool in use
+    unsigned long overflows() const {
+        return overflows_.load(boost::memory_order_relaxed);
+    }
+
+    /// Number of commands seen, at most EXECUTOR_COMMANDS
+    unsigned int commands() const {
+        return commands_.load(boost::memory_order_acquire);
+    }
+
+    const command_stats_t& command(unsigned int index) const {
+        return command_stats_[index];
+    }
+
+private:
+    /// A transaction is completed once, by the executor or by the execute() that gave up waiting
+    enum state_t {
+        QUEUED,
+        COMPLETED,
+        CANCELLED
+    };
+    /// The state is in the two lowest bits, the others count the uses of the transaction
+    static const unsigned int STATE_MASK = 3;
+
+    struct transaction_t {
+        packet_t packet;
+        TransactionPolicy::traffic_t traffic;
+        bool async;
+        unsigned int repeat, attempt;
+        long timeout_ms;
+        TransactionPolicy::clock_t::time_point deadline;
+        callback_t callback;
+        boost::atomic<unsigned int> state;
+
+        transaction_t() : traffic(TransactionPolicy::CONTROL), async(false), repeat(0), attempt(0), timeout_ms(0), state(QUEUED) {
+        }
+    };
+    typedef boost::lockfree::queue<transaction_t*> queue_t;
+
+    ParserPacket* serial_;
+    TransactionPolicy* policy_;
+    boost::thread thread_;
+    boost::atomic<bool> running_;
+    /// Queues by priority, and transactions ready to be used again
+    queue_t control_queue_, config_queue_, background_queue_, free_;
+    /// Number of transactions in the queues
+    boost::interprocess::interprocess_semaphore pending_;
+    /// Answer of the transaction in progress, owned by the executor thread
+    PacketList receive_;
+    command_stats_t command_stats_[EXECUTOR_COMMANDS];
+    boost::atomic<unsigned int> commands_;
+    boost::atomic<unsigned long> sent_, received_, sent_frames_, received_frames_, overflows_;
+
+    transaction_t* acquire();
+    void release(transaction_t* transaction);
+    /// A new use of the transaction, its state QUEUED
+    unsigned int renew(transaction_t* transaction);
+    /**
+     * Queue a transaction with an answer
+     * @param queued if not NULL, its state when queued, to cancel this use of the transaction only
+     * @param deadline if not NULL, its deadline
+     * @return NULL if the policy drops it
+     */
+    transaction_t* schedule(TransactionPolicy::traffic_t traffic, const packet_t& packet, const callback_t& callback,
+                            unsigned int* queued = NULL, TransactionPolicy::clock_t::time_point* deadline = NULL);
+    void enqueue(transaction_t* transaction);
+    void run();
+    /// @return false if the transaction is queued again for its next attempt
+    bool process(transaction_t* transaction);
+    /// Call the callback, unless the transaction was cancelled
+    void complete(transaction_t* transaction, bool success, const PacketList& receive);
+    /// Fail every transaction still queued
+    void drain();
+    /// Statistics of a message, added at the first one, NULL if the table is full
+    command_stats_t* find(const unsigned char* message);
+    /// Statistics of every command in the frame, each one once, with the bytes of its messages
+    unsigned int statistics(const packet_t& packet, command_stats_t** stats, unsigned long* bytes);
+    void countSent(const packet_t& packet, command_stats_t** stats, const unsigned long* bytes, unsigned int commands);
+    void countReceived(const packet_t& packet);
+};
+
+#endif // SERIAL_EXECUTOR_H
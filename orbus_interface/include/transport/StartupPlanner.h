@@ -0,0 +1,102 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#ifndef STARTUP_PLANNER_H
+#define STARTUP_PLANNER_H
+
+#include "serial_parser_packet/ParserPacket.h"
+#include "transport/SerialExecutor.h"
+
+/**
+ * Startup exchange with the board in the fewest frames.
+ *
+ * Every component adds its queries and writes with add(), with a callback
+ * for the answer. run() packs all messages in frames as large as the
+ * serial buffer, queues all frames on the executor together and gives
+ * every answer back to the component that asked for it. post() does the
+ * same without waiting, the answers are given back on the executor thread.
+ */
+class StartupPlanner {
+public:
+    /// Called with the answer to the message: data, ACK or NACK
+    typedef boost::function<void (const packet_information_t&) > callback_reply_t;
+    /// Called when all frames are closed, with the number of messages without answer
+    typedef boost::function<void (unsigned int) > callback_done_t;
+
+    StartupPlanner(ParserPacket* serial, SerialExecutor* executor);
+
+    void add(const packet_information_t& packet, const callback_reply_t& callback = callback_reply_t());
+
+    /**
+     * Send all messages and dispatch the answers
+     * @return number of messages without answer
+     */
+    unsigned int run();
+
+    /// Send all messages without waiting, the planner must live until done is called
+    void post(const callback_done_t& done);
+
+    void clear();
+
+    size_t size() const {
+        return requests_.size();
+    }
+
+private:
+    struct request_t {
+        packet_information_t packet;
+        callback_reply_t callback;
+        bool answered;
+    };
+
+    struct frame_t {
+        size_t begin, end;
+        bool success;
+        std::vector<packet_information_t> receive;
+    };
+
+    ParserPacket* serial_;
+    SerialExecutor* executor_;
+    std::vector<request_t> requests_;
+    std::vector<frame_t> frames_;
+    /// Frames still without answer
+    boost::atomic<unsigned int> remaining_;
+    callback_done_t done_;
+
+    /// Split the messages in frames, every frame is a range of requests_
+    std::vector<std::pair<size_t, size_t> > split();
+    void complete(size_t index, bool success, const PacketList& receive);
+    void finish();
+    void dispatch(size_t begin, size_t end, const std::vector<packet_information_t>& receive);
+};
+
+#endif // STARTUP_PLANNER_H
@@ -0,0 +1,110 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#ifndef TRANSACTION_POLICY_H
+#define TRANSACTION_POLICY_H
+
+#include <boost/atomic.hpp>
+#include <boost/chrono.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+/**
+ * Retries and timeout of every serial transaction.
+ *
+ * Control traffic must end inside the control period: every transaction
+ * gets the time left in the current cycle, shared between its attempts,
+ * and is dropped when the time left is too short. Configuration traffic
+ * has a fixed number of retries, and every attempt waits at most one
+ * control period, so that a control tick is never queued behind a long
+ * exchange. Background traffic only uses the time left in the cycle by the
+ * control traffic, without retries.
+ */
+class TransactionPolicy {
+public:
+    enum traffic_t {
+        CONTROL,
+        CONFIGURATION,
+        BACKGROUND
+    };
+
+    typedef boost::chrono::steady_clock clock_t;
+
+    /// Retries and timeout of every attempt of a transaction
+    struct attempt_t {
+        unsigned int repeat;
+        boost::posix_time::millisec timeout;
+        /// After it the transaction is useless, and dropped if still queued
+        clock_t::time_point deadline;
+
+        attempt_t() : repeat(0), timeout(0) {
+        }
+    };
+
+    TransactionPolicy();
+
+    /**
+     * Budget of the control traffic
+     * @param period control period [s]
+     * @param ratio part of the period available for the serial link
+     * @param repeat retries of a control transaction
+     */
+    void setControl(double period, double ratio = 0.8, unsigned int repeat = 1);
+    void setConfiguration(unsigned int repeat, unsigned int timeout_ms);
+
+    /// Start a new control cycle, called from the control thread
+    void startCycle();
+
+    /**
+     * Retries and timeout of the next transaction, from any thread
+     * @return false if the transaction cannot end in time and must be dropped
+     */
+    bool schedule(traffic_t traffic, attempt_t* attempt);
+
+    /// A control transaction past its deadline when the executor reached it
+    void expired() {
+        dropped_++;
+    }
+
+    /// Control transactions dropped for lack of time
+    unsigned int dropped() const {
+        return dropped_;
+    }
+
+private:
+    clock_t::duration period_, control_budget_;
+    unsigned int control_repeat_;
+    unsigned int config_repeat_, config_timeout_ms_;
+    /// End of the serial budget of the current cycle, ticks of clock_t
+    boost::atomic<clock_t::rep> deadline_;
+    boost::atomic<unsigned int> dropped_;
+};
+
+#endif // TRANSACTION_POLICY_H
@@ -0,0 +1,339 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+
+#include <ros/ros.h>
+#include "hardware/UNAVHardware.h"
+#include "realtime/AllocationCounter.h"
+#include "realtime/RealtimeLoop.h"
+#include "emulator/EmulatorLoop.h"
+#include "controller_manager/controller_manager.h"
+#include <controller_manager_msgs/SwitchController.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/chrono.hpp>
+#include <boost/lexical_cast.hpp>
+
+typedef boost::chrono::steady_clock time_source;
+
+namespace
+{
+  /// Options of all the runs of the sweep
+  struct sweep_t {
+      /// Seconds before and during the measure of every run
+      double warmup, duration;
+      PtyLink::impairment_t impairment;
+      BoardEmulator::options_t board;
+      RealtimeLoop::options_t realtime;
+      /// Controllers started in every run
+      std::vector<std::string> controllers;
+      /// Parameters of the driver, copied in every run
+      XmlRpc::XmlRpcValue hardware;
+      /// Most allocations in a phase of a tick, negative without limit
+      double max_allocations;
+  };
+
+  /// Control loop of a run, every sample in microseconds
+  struct run_t {
+      UNAVHardware* interface;
+      controller_manager::ControllerManager* cm;
+      time_source::time_point last, record_start;
+      /// Samples allocated before the start, only the control thread writes them
+      std::vector<double> read, update, write, cycle, period;
+      size_t count;
+      /// Allocations of every phase in the ticks measured
+      AllocationCounter::sample_t allocations[ORBHardware::LOOP_PHASES];
+  };
+
+  double microseconds(const time_source::duration& duration) {
+      return boost::chrono::duration<double, boost::micro>(duration).count();
+  }
+
+  /// Same phases of controlLoop in unav_hwinterface, each one timed
+  void controlLoop(run_t& run) {
+      time_source::time_point start = time_source::now();
+      ros::Duration elapsed(boost::chrono::duration<double>(start - run.last).count());
+      time_source::duration period = start - run.last;
+      run.last = start;
+
+      run.interface->reportLoopDuration(elapsed);
+      AllocationCounter::sample_t allocations[ORBHardware::LOOP_PHASES + 1];
+      allocations[0] = AllocationCounter::sample();
+      run.interface->updateJointsFromHardware();
+      time_source::time_point read = time_source::now();
+      allocations[1] = AllocationCounter::sample();
+      run.cm->update(ros::Time::now(), elapsed);
+      time_source::time_point update = time_source::now();
+      allocations[2] = AllocationCounter::sample();
+      run.interface->writeCommandsToHardware(elapsed);
+      time_source::time_point write = time_source::now();
+      allocations[3] = AllocationCounter::sample();
+      run.interface->reportCycleDuration(ros::Duration(boost::chrono::duration<double>(write - start).count()));
+
+      if (start < run.record_start || run.count >= run.cycle.size())
+          return;
+      for (unsigned int i = 0; i < ORBHardware::LOOP_PHASES; ++i) {
+          AllocationCounter::sample_t phase = allocations[i + 1] - allocations[i];
+          run.allocations[i].count += phase.count;
+          run.allocations[i].bytes += phase.bytes;
+      }
+      run.read[run.count] = microseconds(read - start);
+      run.update[run.count] = microseconds(update - read);
+      run.write[run.count] = microseconds(write - update);
+      run.cycle[run.count] = microseconds(write - start);
+      run.period[run.count] = microseconds(period);
+      run.count++;
+  }
+
+  /// Percentiles of the first count samples, as a JSON object
+  void printStatistics(FILE* out, const char* name, std::vector<double> samples, size_t count) {
+      samples.resize(count);
+      std::sort(samples.begin(), samples.end());
+      if (samples.empty()) {
+          fprintf(out, "\"%s\":null", name);
+          return;
+      }
+      const double percentiles[] = {0.5, 0.9, 0.99, 0.999};
+      const char* names[] = {"p50", "p90", "p99", "p999"};
+      fprintf(out, "\"%s\":{", name);
+      for (unsigned int i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+          size_t index = (size_t) (percentiles[i] * (samples.size() - 1) + 0.5);
+          fprintf(out, "\"%s\":%.1f,", names[i], samples[index]);
+      }
+      fprintf(out, "\"max\":%.1f}", samples.back());
+  }
+
+  std::vector<double> readList(const ros::NodeHandle& nh, const std::string& name, const std::vector<double>& fallback) {
+      XmlRpc::XmlRpcValue list;
+      if (!nh.getParam(name, list) || list.getType() != XmlRpc::XmlRpcValue::TypeArray)
+          return fallback;
+      std::vector<double> values;
+      for (int i = 0; i < list.size(); ++i) {
+          if (list[i].getType() == XmlRpc::XmlRpcValue::TypeInt)
+              values.push_back((int) list[i]);
+          else if (list[i].getType() == XmlRpc::XmlRpcValue::TypeDouble)
+              values.push_back((double) list[i]);
+      }
+      return values;
+  }
+
+  /**
+  * Run the driver against a new emulated board, one line of JSON for the run
+  * @param allocations most allocations in a phase of a tick, on average
+  * @return false if the driver did not start
+  */
+  bool runPoint(const ros::NodeHandle& nh, const ros::NodeHandle& private_nh, sweep_t& sweep,
+                unsigned int index, double frequency, double rate, FILE* out, double* allocations) {
+      fprintf(out, "{\"control_frequency\":%.1f,\"serial_rate\":%.0f,", frequency, rate);
+
+      PtyLink::impairment_t impairment = sweep.impairment;
+      impairment.baud = (unsigned int) rate;
+      PtyLink link(impairment);
+      if (!link.open()) {
+          fprintf(out, "\"error\":\"Cannot open the pseudo-terminal\"}\n");
+          return false;
+      }
+      BoardEmulator board(sweep.board);
+      EmulatorLoop emulator(&board, &link);
+      emulator.start();
+
+      /// Every run in its namespace, the dynamic reconfigure servers of a run never meet the others
+      ros::NodeHandle run_nh(private_nh, "run_" + boost::lexical_cast<std::string>(index));
+      if (sweep.hardware.getType() == XmlRpc::XmlRpcValue::TypeStruct) {
+          for (XmlRpc::XmlRpcValue::iterator it = sweep.hardware.begin(); it != sweep.hardware.end(); ++it)
+              run_nh.setParam(it->first, it->second);
+      }
+      run_nh.setParam("serial_port", link.name());
+      run_nh.setParam("serial_rate", rate);
+      run_nh.setParam("control_frequency", frequency);
+      /// Every run starts from the board
+      run_nh.setParam("config_cache", false);
+
+      bool started = false;
+      ParserPacket* serial = NULL;
+      try {
+          serial = new ParserPacket(link.name().c_str(), rate);
+          UNAVHardware interface(nh, run_nh, serial);
+          controller_manager::ControllerManager cm(&interface, nh);
+
+          run_t run;
+          size_t capacity = (size_t) (sweep.duration * frequency * 1.1) + 1;
+          run.read.resize(capacity);
+          run.update.resize(capacity);
+          run.write.resize(capacity);
+          run.cycle.resize(capacity);
+          run.period.resize(capacity);
+          run.count = 0;
+          run.interface = &interface;
+          run.cm = &cm;
+          run.last = time_source::now();
+          run.record_start = run.last + boost::chrono::microseconds((long) (sweep.warmup * 1e6));
+
+          RealtimeLoop loop(frequency, boost::bind(controlLoop, boost::ref(run)), sweep.realtime);
+          interface.startStream(ros::getGlobalCallbackQueue());
+          loop.start();
+          started = true;
+          if (!sweep.controllers.empty()) {
+              /// The switch is done by cm.update, in the control loop
+              for (std::vector<std::string>::iterator it = sweep.controllers.begin(); it != sweep.controllers.end(); ++it)
+                  cm.loadController(*it);
+              cm.switchController(sweep.controllers, std::vector<std::string>(),
+                                  controller_manager_msgs::SwitchController::Request::STRICT);
+          }
+
+          boost::this_thread::sleep_until(run.record_start);
+          unsigned long sent = link.sent(), received = link.received();
+          unsigned int overruns = loop.overruns();
+          boost::this_thread::sleep_for(boost::chrono::microseconds((long) (sweep.duration * 1e6)));
+          loop.stop();
+          sent = link.sent() - sent;
+          received = link.received() - received;
+          overruns = loop.overruns() - overruns;
+
+          double mean_period = 0;
+          for (size_t i = 0; i < run.count; ++i)
+              mean_period += run.period[i];
+          mean_period = (run.count > 0) ? mean_period / run.count : 0;
+          /// Jitter as distance of every period from the nominal one
+          std::vector<double> jitter(run.count);
+          for (size_t i = 0; i < run.count; ++i)
+              jitter[i] = fabs(run.period[i] - 1e6 / frequency);
+
+          /// 10 bits every byte, start and stop included
+          fprintf(out, "\"cycles\":%zu,\"rate\":%.2f,\"missed_deadlines\":%u,", run.count,
+                  (mean_period > 0) ? 1e6 / mean_period : 0.0, overruns);
+          printStatistics(out, "read_us", run.read, run.count);
+          fprintf(out, ",");
+          printStatistics(out, "update_us", run.update, run.count);
+          fprintf(out, ",");
+          printStatistics(out, "write_us", run.write, run.count);
+          fprintf(out, ",");
+          printStatistics(out, "cycle_us", run.cycle, run.count);
+          fprintf(out, ",");
+          printStatistics(out, "jitter_us", jitter, jitter.size());
+          fprintf(out, ",\"utilisation\":{\"tx\":%.4f,\"rx\":%.4f},", received * 10.0 / (rate * sweep.duration),
+                  sent * 10.0 / (rate * sweep.duration));
+          const char* phases[ORBHardware::LOOP_PHASES] = {"read", "update", "write"};
+          fprintf(out, "\"allocs_per_tick\":{");
+          for (unsigned int i = 0; i < ORBHardware::LOOP_PHASES; ++i) {
+              double per_tick = (run.count > 0) ? (double) run.allocations[i].count / run.count : 0.0;
+              *allocations = std::max(*allocations, per_tick);
+              fprintf(out, "%s\"%s\":%.2f", (i > 0) ? "," : "", phases[i], per_tick);
+          }
+          fprintf(out, "},");
+      } catch (std::exception &e) {
+          fprintf(out, "\"error\":\"%s\",", e.what());
+      }
+      if (serial != NULL) {
+          serial->close();
+          delete serial;
+      }
+      emulator.stop();
+      fprintf(out, "\"emulator\":{\"frames\":%u,\"errors\":%u}}\n", board.frames(), board.errors());
+      fflush(out);
+      return started;
+  }
+}
+
+/**
+* Sweep of control frequency and baud rate against an emulated board,
+* every run is printed as a line of JSON
+*/
+int main(int argc, char **argv) {
+
+    ros::init(argc, argv, "unav_benchmark");
+    ros::NodeHandle nh, private_nh("~");
+
+    sweep_t sweep;
+    private_nh.param<double>("warmup", sweep.warmup, 2.0);
+    private_nh.param<double>("duration", sweep.duration, 10.0);
+    std::vector<double> frequencies = readList(private_nh, "control_frequencies",
+                                               boost::assign::list_of(10.0)(50.0)(100.0)(200.0));
+    std::vector<double> rates = readList(private_nh, "serial_rates",
+                                         boost::assign::list_of(57600.0)(115200.0)(230400.0));
+    //Emulated board and link
+    int seed;
+    private_nh.param<double>("emulator/latency", sweep.impairment.latency, 0.5);
+    private_nh.param<double>("emulator/jitter", sweep.impairment.jitter, 0.0);
+    private_nh.param<double>("emulator/corruption", sweep.impairment.corruption, 0.0);
+    private_nh.param<int>("emulator/seed", seed, 1);
+    private_nh.param<double>("emulator/time_constant", sweep.board.time_constant, 0.05);
+    sweep.impairment.seed = seed;
+    //Control loop, the same options of hardware_unav
+    int stack_prefault;
+    private_nh.param<int>("realtime/priority", sweep.realtime.priority, 0);
+    private_nh.param<int>("realtime/cpu", sweep.realtime.cpu, -1);
+    private_nh.param<bool>("realtime/lock_memory", sweep.realtime.lock_memory, false);
+    private_nh.param<int>("realtime/stack_prefault", stack_prefault, 64 * 1024);
+    sweep.realtime.stack_prefault = stack_prefault;
+    private_nh.param<std::vector<std::string> >("controllers", sweep.controllers, std::vector<std::string>());
+    private_nh.getParam("hardware", sweep.hardware);
+    private_nh.param<double>("max_allocations_per_tick", sweep.max_allocations, -1.0);
+
+    std::string output;
+    private_nh.param<std::string>("output", output, "");
+    FILE* out = output.empty() ? stdout : fopen(output.c_str(), "w");
+    if (out == NULL) {
+        ROS_ERROR("Cannot open %s", output.c_str());
+        return 1;
+    }
+
+    // Timers of the driver, e.g. the measure stream, and controller manager services
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+
+    unsigned int index = 0;
+    bool passed = true;
+    for (std::vector<double>::iterator rate = rates.begin(); rate != rates.end() && ros::ok(); ++rate) {
+        for (std::vector<double>::iterator frequency = frequencies.begin(); frequency != frequencies.end() && ros::ok(); ++frequency) {
+            ROS_INFO("Run %u: control_frequency %.1f Hz serial_rate %.0f", index, *frequency, *rate);
+            double allocations = 0;
+            if (!runPoint(nh, private_nh, sweep, index++, *frequency, *rate, out, &allocations)) {
+                ROS_ERROR("Run %u: the driver did not start", index - 1);
+                passed = false;
+            } else if (sweep.max_allocations >= 0 && allocations > sweep.max_allocations) {
+                ROS_ERROR("Run %u: %.2f allocations in a phase of a tick, more than %.2f",
+                          index - 1, allocations, sweep.max_allocations);
+                passed = false;
+            }
+        }
+    }
+
+    if (out != stdout)
+        fclose(out);
+    spinner.stop();
+    return passed ? 0 : 1;
+}
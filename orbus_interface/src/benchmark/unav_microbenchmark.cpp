@@ -0,0 +1,233 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#include <ros/ros.h>
+#include "hardware/UNAVHardware.h"
+#include "transport/FrameTemplate.h"
+#include "realtime/AllocationCounter.h"
+#include "emulator/EmulatorLoop.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <boost/chrono.hpp>
+
+typedef boost::chrono::steady_clock time_source;
+
+namespace
+{
+  /**
+  * Repeat the operation, ten times more until min_time is over,
+  * one line of JSON with time and allocations of an operation
+  */
+  template <class T> void measure(FILE* out, const char* name, T& operation, double min_time) {
+      unsigned long iterations = 1;
+      while (true) {
+          AllocationCounter::sample_t start_allocations = AllocationCounter::sample();
+          time_source::time_point start = time_source::now();
+          for (unsigned long i = 0; i < iterations; ++i)
+              operation();
+          double elapsed = boost::chrono::duration<double>(time_source::now() - start).count();
+          unsigned long used = (AllocationCounter::sample() - start_allocations).count;
+          if (elapsed >= min_time || iterations >= 1000000000UL) {
+              fprintf(out, "{\"name\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f}\n",
+                      name, iterations, elapsed * 1e9 / iterations, (double) used / iterations);
+              fflush(out);
+              return;
+          }
+          iterations *= 10;
+      }
+  }
+
+  struct create_data_t {
+      ParserPacket* serial;
+      packet_information_t result;
+
+      void operator()() {
+          motor_command_map_t command;
+          command.bitset.motor = 0;
+          command.bitset.command = MOTOR_VEL_REF;
+          motor_control_t velocity = 1000;
+          result = serial->createDataPacket(command.command_message, HASHMAP_MOTOR, (message_abstract_u*) & velocity);
+      }
+  };
+
+  struct encoder_t {
+      ParserPacket* serial;
+      std::vector<packet_information_t> list_send;
+      packet_t result;
+
+      void operator()() {
+          result = serial->encoder(list_send);
+      }
+  };
+
+  struct parsing_t {
+      ParserPacket* serial;
+      packet_t packet;
+      size_t messages, errors;
+
+      void operator()() {
+          try {
+              /// Messages decoded and dispatched to the callbacks
+              messages += serial->parsing(packet).size();
+          } catch (std::exception& e) {
+              errors++;
+          }
+      }
+  };
+
+  /// Velocity references packed as in writeCommandsToHardware
+  struct packing_t {
+      FrameTemplate frame;
+      PacketList list_write;
+      double velocity[NUM_MOTORS];
+
+      void operator()() {
+          for (int i = 0; i < NUM_MOTORS; ++i) {
+              velocity[i] = -velocity[i];
+              motor_control_t reference = UNAVHardware::velocityToBoard(velocity[i]);
+              frame.patch(i, reference);
+              memcpy(&list_write[i].message, &reference, sizeof(reference));
+          }
+      }
+  };
+
+  packet_information_t velocityPacket(ParserPacket* serial, unsigned int motor, motor_control_t velocity) {
+      motor_command_map_t command;
+      command.bitset.motor = motor;
+      command.bitset.command = MOTOR_VEL_REF;
+      return serial->createDataPacket(command.command_message, HASHMAP_MOTOR, (message_abstract_u*) & velocity);
+  }
+
+  /// Answer of the board to the measure requests of all motors
+  packet_t measurePacket(ParserPacket* serial) {
+      std::vector<packet_information_t> list_measure;
+      motor_command_map_t command;
+      command.bitset.command = MOTOR_MEASURE;
+      for (int i = 0; i < NUM_MOTORS; ++i) {
+          command.bitset.motor = i;
+          motor_t motor;
+          motor.position = 100;
+          motor.velocity = 1000;
+          motor.torque = 10;
+          motor.position_delta = 5;
+          list_measure.push_back(serial->createDataPacket(command.command_message, HASHMAP_MOTOR, (message_abstract_u*) & motor));
+      }
+      return serial->encoder(list_measure);
+  }
+}
+
+/**
+* Time and allocations of the encoding and decoding done every control tick
+*/
+int main(int argc, char **argv) {
+
+    ros::init(argc, argv, "unav_microbenchmark");
+    ros::NodeHandle nh, private_nh("~");
+
+    double min_time;
+    private_nh.param<double>("min_time", min_time, 0.5);
+    FILE* out = stdout;
+
+    /// The serial port of the driver is an emulated board
+    PtyLink link;
+    if (!link.open()) {
+        ROS_ERROR("Cannot open the pseudo-terminal");
+        return 1;
+    }
+    BoardEmulator board;
+    EmulatorLoop emulator(&board, &link);
+    emulator.start();
+
+    ParserPacket* serial = NULL;
+    try {
+        serial = new ParserPacket(link.name().c_str(), 115200);
+
+        create_data_t create_data;
+        create_data.serial = serial;
+        measure(out, "createDataPacket", create_data, min_time);
+
+        encoder_t encoder;
+        encoder.serial = serial;
+        encoder.list_send.push_back(velocityPacket(serial, 0, 1000));
+        measure(out, "encoder/1", encoder, min_time);
+        encoder.list_send.push_back(velocityPacket(serial, 1, -1000));
+        measure(out, "encoder/2", encoder, min_time);
+        /// As many references as a frame can hold
+        size_t length = sizeof(((packet_t*) NULL)->buffer) / (LNG_HEAD_INFORMATION_PACKET + sizeof(motor_control_t));
+        while (encoder.list_send.size() < length)
+            encoder.list_send.push_back(velocityPacket(serial, encoder.list_send.size() % NUM_MOTORS, 1000));
+        std::string name = "encoder/" + boost::lexical_cast<std::string>(length);
+        measure(out, name.c_str(), encoder, min_time);
+
+        parsing_t parsing;
+        parsing.serial = serial;
+        parsing.messages = parsing.errors = 0;
+        parsing.packet = measurePacket(serial);
+        packet_t valid = parsing.packet;
+        measure(out, "parsing/valid", parsing, min_time);
+        /// Length of the second message out of the frame
+        unsigned int second = parsing.packet.buffer[0];
+        parsing.packet.buffer[second] = 0xFF;
+        measure(out, "parsing/corrupted_length", parsing, min_time);
+        /// Unknown hashmap in the first message
+        parsing.packet = valid;
+        parsing.packet.buffer[2] ^= 0xFF;
+        measure(out, "parsing/corrupted_type", parsing, min_time);
+
+        packing_t packing;
+        for (int i = 0; i < NUM_MOTORS; ++i) {
+            packing.velocity[i] = 0.5 * (i + 1);
+            packing.list_write.push_back(velocityPacket(serial, i, 0));
+        }
+        packing.frame.build(serial, packing.list_write);
+        measure(out, "writeCommandsToHardware/packing", packing, min_time);
+
+        /// The same measures dispatched to motorPacket
+        ros::NodeHandle hardware_nh(private_nh, "hardware");
+        hardware_nh.setParam("config_cache", false);
+        {
+            UNAVHardware interface(nh, hardware_nh, serial);
+            parsing.packet = valid;
+            measure(out, "parsing/motorPacket", parsing, min_time);
+        }
+    } catch (std::exception &e) {
+        ROS_ERROR("%s", e.what());
+    }
+    if (serial != NULL) {
+        serial->close();
+        delete serial;
+    }
+    emulator.stop();
+    return 0;
+}
@@ -0,0 +1,168 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#include "configurator/ConfigCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <errno.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace
+{
+  /// Only letters, numbers, - and _ in the name of the file
+  std::string sanitize(const std::string& name) {
+      std::string out(name);
+      for (size_t i = 0; i < out.size(); ++i) {
+          char c = out[i];
+          if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_'))
+              out[i] = '_';
+      }
+      return out;
+  }
+
+  bool makeDirectory(const std::string& path) {
+      return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+  }
+
+  std::string rosHome() {
+      const char* ros_home = getenv("ROS_HOME");
+      if (ros_home != NULL)
+          return ros_home;
+      const char* home = getenv("HOME");
+      if (home != NULL)
+          return std::string(home) + "/.ros";
+      return "";
+  }
+}
+
+ConfigCache::ConfigCache() : loaded_(false), dirty_(false) {
+}
+
+void ConfigCache::open(const std::string& name, const std::string& type, const std::string& version, const std::string& date) {
+    std::string home = rosHome();
+    if (home.empty()) {
+        ROS_WARN("Configuration cache: no ROS_HOME or HOME, cache disabled");
+        return;
+    }
+    std::string directory = home + "/orbus_interface";
+    if (!makeDirectory(home) || !makeDirectory(directory)) {
+        ROS_WARN("Configuration cache: cannot create %s, cache disabled", directory.c_str());
+        return;
+    }
+    path_ = directory + "/" + sanitize(name) + "_" + sanitize(type) + ".xml";
+    version_ = version;
+    date_ = date;
+    loaded_ = true;
+
+    std::ifstream file(path_.c_str());
+    if (!file.good())
+        return;
+    stringstream buffer;
+    buffer << file.rdbuf();
+    int offset = 0;
+    XmlRpc::XmlRpcValue cache(buffer.str(), &offset);
+    if (cache.getType() != XmlRpc::XmlRpcValue::TypeStruct || !cache.hasMember("version")
+            || !cache.hasMember("date") || !cache.hasMember("params")) {
+        ROS_WARN("Configuration cache: %s is not valid, ignored", path_.c_str());
+        return;
+    }
+    /// Another firmware can have other defaults
+    if (static_cast<std::string&>(cache["version"]) != version_ || static_cast<std::string&>(cache["date"]) != date_) {
+        ROS_INFO("Configuration cache: firmware changed, %s invalidated", path_.c_str());
+        dirty_ = true;
+        return;
+    }
+    params_ = cache["params"];
+    ROS_INFO("Configuration cache: loaded %s", path_.c_str());
+}
+
+bool ConfigCache::restore(const ros::NodeHandle& nh, const std::string& name) {
+    if (!loaded_ || params_.getType() != XmlRpc::XmlRpcValue::TypeStruct || !params_.hasMember(name))
+        return false;
+    nh.setParam(name, params_[name]);
+    return true;
+}
+
+void ConfigCache::store(const ros::NodeHandle& nh, const std::string& name) {
+    if (!loaded_)
+        return;
+    XmlRpc::XmlRpcValue value;
+    if (!nh.getParam(name, value))
+        return;
+    params_[name] = value;
+    dirty_ = true;
+}
+
+void ConfigCache::changed(const ros::NodeHandle& nh, const std::string& name) {
+    if (!loaded_)
+        return;
+    boost::mutex::scoped_lock lock(mutex_);
+    changed_[name] = nh;
+}
+
+bool ConfigCache::save() {
+    std::map<std::string, ros::NodeHandle> changed;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        changed.swap(changed_);
+    }
+    for (std::map<std::string, ros::NodeHandle>::iterator it = changed.begin(); it != changed.end(); ++it)
+        store(it->second, it->first);
+    if (!loaded_ || !dirty_)
+        return true;
+    XmlRpc::XmlRpcValue cache;
+    cache["version"] = version_;
+    cache["date"] = date_;
+    cache["params"] = params_;
+    /// Write a new file and replace the old one, never a half written cache
+    std::string temp = path_ + ".tmp";
+    {
+        std::ofstream file(temp.c_str());
+        file << cache.toXml();
+        if (!file.good()) {
+            ROS_WARN("Configuration cache: cannot write %s", temp.c_str());
+            return false;
+        }
+    }
+    if (rename(temp.c_str(), path_.c_str()) != 0) {
+        ROS_WARN("Configuration cache: cannot write %s", path_.c_str());
+        return false;
+    }
+    dirty_ = false;
+    return true;
+}
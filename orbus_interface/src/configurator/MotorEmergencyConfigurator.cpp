@@ -31,56 +31,77 @@
 
 #include "configurator/MotorEmergencyConfigurator.h"
 
+#include <string.h>
+
 using namespace std;
 
-MotorEmergencyConfigurator::MotorEmergencyConfigurator(const ros::NodeHandle& nh, std::string name, unsigned int number, ParserPacket *serial)
-    : nh_(nh), serial_(serial)
+MotorEmergencyConfigurator::MotorEmergencyConfigurator(const ros::NodeHandle& nh, std::string name, unsigned int number, ParserPacket *serial, ShadowSync* shadow)
+    : nh_(nh), serial_(serial), shadow_(shadow), cache_(NULL), timeout_(0), setup_(false), dsrv_(NULL)
 {
     //Namespace
     name_ = name + "/emergency";
     // Set command message
     command_.bitset.motor = number;
     command_.bitset.command = MOTOR_EMERGENCY;
+}
 
-    /// Check existence namespace otherwise get information from board
-    if (!nh_.hasParam(name_)) {
-        /// Build a list of messages
-        std::vector<packet_information_t> list_send;
-        list_send.push_back(serial->createPacket(command_.command_message, PACKET_REQUEST, HASHMAP_MOTOR));
+void MotorEmergencyConfigurator::plan(StartupPlanner* planner, ConfigCache* cache) {
+    cache_ = cache;
+    /// The values written by reconfigure are cached for the next launch
+    shadow_->acknowledged(HASHMAP_MOTOR, command_.command_message,
+                          boost::bind(&ConfigCache::changed, cache_, nh_, name_));
+    /// Check existence namespace otherwise get information from cache or board
+    if (nh_.hasParam(name_)) {
+        /// Read the board, the configuration is written only if different
+        motor_emergency_t emergency = getEmergency();
+        shadow_->stage(HASHMAP_MOTOR, command_.command_message, &emergency, sizeof(emergency));
+        shadow_->read(planner, HASHMAP_MOTOR, command_.command_message, sizeof(emergency));
+    } else if (!cache_->restore(nh_, name_)) {
+        planner->add(serial_->createPacket(command_.command_message, PACKET_REQUEST, HASHMAP_MOTOR),
+                     boost::bind(&MotorEmergencyConfigurator::decodeReply, this, _1));
+    }
+}
 
-        /// Build a packet
-        packet_t packet = serial->encoder(list_send);
-        /// Receive information
-        vector<packet_information_t> receive = serial->parsing(serial->sendSyncPacket(packet));
-        /// Decode all messages
-        for (vector<packet_information_t>::iterator list_iter = receive.begin(); list_iter != receive.end(); ++list_iter) {
-            packet_information_t packet = (*list_iter);
-            switch (packet.option) {
-            case PACKET_NACK:
-                ///< Send a message ERROR
-                break;
-            case PACKET_DATA:
-                if (packet.type == HASHMAP_MOTOR) {
-                    if(packet.command = command_.command_message) {
-                        nh_.setParam(name_ + "/Slope_time", packet.message.motor.pid.kp);
-                        nh_.setParam(name_ + "/Bridge_off", packet.message.motor.pid.ki);
-                        nh_.setParam(name_ + "/Timeout", packet.message.motor.pid.kd);
-                    }
-                }
-                break;
-            }
-        }
+void MotorEmergencyConfigurator::decodeReply(const packet_information_t& packet) {
+    switch (packet.option) {
+    case PACKET_NACK:
+        ///< Send a message ERROR
+        break;
+    case PACKET_DATA:
+        nh_.setParam(name_ + "/Slope_time", packet.message.motor.emergency.slope_time);
+        nh_.setParam(name_ + "/Bridge_off", packet.message.motor.emergency.bridge_off);
+        nh_.setParam(name_ + "/Timeout", (int) packet.message.motor.emergency.timeout);
+        shadow_->confirm(HASHMAP_MOTOR, command_.command_message, &packet.message.motor.emergency, sizeof(motor_emergency_t));
+        cache_->store(nh_, name_);
+        break;
     }
+}
 
+void MotorEmergencyConfigurator::initialize() {
     //Load dynamic reconfigure
     dsrv_ = new dynamic_reconfigure::Server<orbus_interface::UnavEmergencyConfig>(ros::NodeHandle("~" + name_));
     dynamic_reconfigure::Server<orbus_interface::UnavEmergencyConfig>::CallbackType cb = boost::bind(&MotorEmergencyConfigurator::reconfigureCB, this, _1, _2);
     dsrv_->setCallback(cb);
 }
 
-void MotorEmergencyConfigurator::reconfigureCB(orbus_interface::UnavEmergencyConfig &config, uint32_t level) {
+motor_emergency_t MotorEmergencyConfigurator::getEmergency() {
+    motor_emergency_t emergency;
+    int temp_int;
+    double temp_double;
+    memset(&emergency, 0, sizeof(emergency));
+    nh_.getParam(name_ + "/Slope_time", temp_double);
+    emergency.slope_time = (float) temp_double;
+    nh_.getParam(name_ + "/Bridge_off", temp_double);
+    emergency.bridge_off = (float) temp_double;
+    nh_.getParam(name_ + "/Timeout", temp_int);
+    emergency.timeout = (uint16_t) temp_int;
+    return emergency;
+}
+
+void MotorEmergencyConfigurator::reconfigureCB(orbus_interface::UnavEmergencyConfig &config, uint32_t) {
 
     motor_emergency_t emergency;
+    memset(&emergency, 0, sizeof(emergency));
     emergency.bridge_off = (float) config.Bridge_off;
     emergency.slope_time = (float) config.Slope_time;
     emergency.timeout = (uint16_t) config.Timeout;
@@ -91,6 +112,7 @@ void MotorEmergencyConfigurator::reconfigureCB(orbus_interface::UnavEmergencyCon
     {
       last_emergency_ = emergency;
       default_emer_ = last_emergency_;
+      timeout_ = emergency.timeout;
       setup_ = true;
       return;
     }
@@ -101,12 +123,8 @@ void MotorEmergencyConfigurator::reconfigureCB(orbus_interface::UnavEmergencyCon
       config.restore_defaults = false;
     }
 
-    packet_t packet_send = serial_->encoder(serial_->createDataPacket(command_.command_message, HASHMAP_MOTOR, (message_abstract_u*) & emergency));
-
-    try {
-        serial_->sendSyncPacket(packet_send, 3, boost::posix_time::millisec(200));
-    } catch (exception &e) {
-        ROS_ERROR("%s", e.what());
-    }
+    /// Sent by the next diagnostic tick, only if different from the board
+    shadow_->stage(HASHMAP_MOTOR, command_.command_message, &emergency, sizeof(emergency));
     last_emergency_ = emergency;
+    timeout_ = emergency.timeout;
 }
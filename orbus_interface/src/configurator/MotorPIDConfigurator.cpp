@@ -31,10 +31,12 @@
 
 #include "configurator/MotorPIDConfigurator.h"
 
+#include <string.h>
+
 using namespace std;
 
-MotorPIDConfigurator::MotorPIDConfigurator(const ros::NodeHandle& nh, std::string name, unsigned int number, ParserPacket *serial)
-    : nh_(nh), serial_(serial)
+MotorPIDConfigurator::MotorPIDConfigurator(const ros::NodeHandle& nh, std::string name, unsigned int number, ParserPacket *serial, ShadowSync* shadow)
+    : nh_(nh), serial_(serial), shadow_(shadow), cache_(NULL), setup_(false), dsrv_(NULL)
 {
     //Namespace
     name_ = name + "/pid";
@@ -44,59 +46,65 @@ MotorPIDConfigurator::MotorPIDConfigurator(const ros::NodeHandle& nh, std::strin
     // Set message to frequency information
     last_frequency_.hashmap = HASHMAP_MOTOR;
     last_frequency_.number = 0; ///< TODO To correct
+}
 
-    /// Check existence namespace otherwise get information from board
-    if (!nh_.hasParam(name_)) {
-        /// Build a list of messages
-        std::vector<packet_information_t> list_send;
-        list_send.push_back(serial->createPacket(command_.command_message, PACKET_REQUEST, HASHMAP_MOTOR));
-        //list_send.push_back(serial_->createDataPacket(SYSTEM_TASK_FRQ, HASHMAP_MOTOR, (message_abstract_u*) & last_frequency_));
-
-        /// Build a packet
-        packet_t packet = serial->encoder(list_send);
-        /// Receive information
-        vector<packet_information_t> receive = serial->parsing(serial->sendSyncPacket(packet));
-        /// Decode all messages
-        for (vector<packet_information_t>::iterator list_iter = receive.begin(); list_iter != receive.end(); ++list_iter) {
-            packet_information_t packet = (*list_iter);
-            switch (packet.option) {
-            case PACKET_NACK:
-                ///< Send a message ERROR
-                break;
-            case PACKET_DATA:
-                if (packet.type == HASHMAP_MOTOR) {
-                    if(packet.command = command_.command_message) {
-                        nh_.setParam(name_ + "/Kp", packet.message.motor.pid.kp);
-                        nh_.setParam(name_ + "/Ki", packet.message.motor.pid.ki);
-                        nh_.setParam(name_ + "/Kd", packet.message.motor.pid.kd);
-                    }
-                }
-                break;
-            }
-        }
-    } else {
+void MotorPIDConfigurator::plan(StartupPlanner* planner, ConfigCache* cache) {
+    cache_ = cache;
+    /// The values written by reconfigure are cached for the next launch
+    shadow_->acknowledged(HASHMAP_MOTOR, command_.command_message,
+                          boost::bind(&ConfigCache::changed, cache_, nh_, name_));
+    /// Check existence namespace otherwise get information from cache or board
+    if (nh_.hasParam(name_)) {
+        /// Read the board, the PID is written only if different
+        motor_pid_t pid = getPID();
+        shadow_->stage(HASHMAP_MOTOR, command_.command_message, &pid, sizeof(pid));
+        shadow_->read(planner, HASHMAP_MOTOR, command_.command_message, sizeof(pid));
+    } else if (!cache_->restore(nh_, name_)) {
+        planner->add(serial_->createPacket(command_.command_message, PACKET_REQUEST, HASHMAP_MOTOR),
+                     boost::bind(&MotorPIDConfigurator::decodeReply, this, _1));
+        //planner->add(serial_->createDataPacket(SYSTEM_TASK_FRQ, HASHMAP_MOTOR, (message_abstract_u*) & last_frequency_));
+    }
+}
 
+void MotorPIDConfigurator::decodeReply(const packet_information_t& packet) {
+    switch (packet.option) {
+    case PACKET_NACK:
+        ///< Send a message ERROR
+        break;
+    case PACKET_DATA:
+        nh_.setParam(name_ + "/Kp", packet.message.motor.pid.kp);
+        nh_.setParam(name_ + "/Ki", packet.message.motor.pid.ki);
+        nh_.setParam(name_ + "/Kd", packet.message.motor.pid.kd);
+        shadow_->confirm(HASHMAP_MOTOR, command_.command_message, &packet.message.motor.pid, sizeof(motor_pid_t));
+        cache_->store(nh_, name_);
+        break;
     }
+}
 
+void MotorPIDConfigurator::initialize() {
     //Load dynamic reconfigure
     dsrv_ = new dynamic_reconfigure::Server<orbus_interface::UnavPIDConfig>(ros::NodeHandle("~" + name_));
     dynamic_reconfigure::Server<orbus_interface::UnavPIDConfig>::CallbackType cb = boost::bind(&MotorPIDConfigurator::reconfigureCB, this, _1, _2);
     dsrv_->setCallback(cb);
 }
 
-void MotorPIDConfigurator::sendToSerial(std::vector<packet_information_t>& list_send) {
-    if(list_send.size() != 0) {
-        try {
-            serial_->parserSendPacket(list_send, 3, boost::posix_time::millisec(200));
-        } catch (exception &e) {
-            ROS_ERROR("%s", e.what());
-        }
-    }
+motor_pid_t MotorPIDConfigurator::getPID() {
+    motor_pid_t pid;
+    double temp_double;
+    memset(&pid, 0, sizeof(pid));
+    nh_.getParam(name_ + "/Kp", temp_double);
+    pid.kp = (float) temp_double;
+    nh_.getParam(name_ + "/Ki", temp_double);
+    pid.ki = (float) temp_double;
+    nh_.getParam(name_ + "/Kd", temp_double);
+    pid.kd = (float) temp_double;
+    return pid;
 }
 
-void MotorPIDConfigurator::reconfigureCB(orbus_interface::UnavPIDConfig &config, uint32_t level) {
+void MotorPIDConfigurator::reconfigureCB(orbus_interface::UnavPIDConfig &config, uint32_t) {
 
     motor_pid_t pid;
+    memset(&pid, 0, sizeof(pid));
     pid.kp = config.Kp;
     pid.ki = config.Ki;
     pid.kd = config.Kd;
@@ -120,18 +128,15 @@ void MotorPIDConfigurator::reconfigureCB(orbus_interface::UnavPIDConfig &config,
       config.restore_defaults = false;
     }
 
-    std::vector<packet_information_t> list_send;
-    if(last_pid_.kp != pid.kp || last_pid_.ki != pid.ki || last_pid_.kd != pid.kd) {
-        list_send.push_back(serial_->createDataPacket(command_.command_message, HASHMAP_MOTOR, (message_abstract_u*) & pid));
-        last_pid_ = pid;
-        config.Kp = pid.kp;
-        config.Ki = pid.ki;
-        config.Kd = pid.kd;
-    }
+    /// Sent by the next diagnostic tick, only if different from the board
+    shadow_->stage(HASHMAP_MOTOR, command_.command_message, &pid, sizeof(pid));
+    last_pid_ = pid;
+    config.Kp = pid.kp;
+    config.Ki = pid.ki;
+    config.Kd = pid.kd;
     if(last_frequency_.data != config.Frequency) {
         // TODO add packet to change frequency
         last_frequency_.data = config.Frequency;
     }
 
-    sendToSerial(list_send);
 }
@@ -31,10 +31,12 @@
 
 #include "configurator/MotorParamConfigurator.h"
 
+#include <string.h>
+
 using namespace std;
 
-MotorParamConfigurator::MotorParamConfigurator(const ros::NodeHandle &nh, std::string name, unsigned int number, ParserPacket *serial)
-    : nh_(nh), serial_(serial)
+MotorParamConfigurator::MotorParamConfigurator(const ros::NodeHandle &nh, std::string name, unsigned int number, ParserPacket *serial, ShadowSync* shadow)
+    : nh_(nh), serial_(serial), shadow_(shadow), cache_(NULL), setup_(false), dsrv_(NULL)
 {
     //Namespace
     name_ = name;// + "/param";
@@ -44,46 +46,46 @@ MotorParamConfigurator::MotorParamConfigurator(const ros::NodeHandle &nh, std::s
     // Set message to frequency information
     last_frequency_.hashmap = HASHMAP_MOTOR;
     last_frequency_.number = 0; ///< TODO To correct
+}
 
-    /// Check existence namespace otherwise get information from board
-    if (!nh_.hasParam(name_)) {
-        /// Build a list of messages
-        std::vector<packet_information_t> list_send;
-        list_send.push_back(serial->createPacket(command_.command_message, PACKET_REQUEST, HASHMAP_MOTOR));
+void MotorParamConfigurator::plan(StartupPlanner* planner, ConfigCache* cache) {
+    cache_ = cache;
+    /// The values written by reconfigure are cached for the next launch
+    shadow_->acknowledged(HASHMAP_MOTOR, command_.command_message,
+                          boost::bind(&ConfigCache::changed, cache_, nh_, name_));
+    /// Check existence namespace otherwise get information from cache or board
+    if (nh_.hasParam(name_)) {
+        /// Read the board, the configuration is written only if different
+        motor_parameter_t parameter = getParam();
+        shadow_->stage(HASHMAP_MOTOR, command_.command_message, &parameter, sizeof(parameter));
+        shadow_->read(planner, HASHMAP_MOTOR, command_.command_message, sizeof(parameter));
+    } else if (!cache_->restore(nh_, name_)) {
+        planner->add(serial_->createPacket(command_.command_message, PACKET_REQUEST, HASHMAP_MOTOR),
+                     boost::bind(&MotorParamConfigurator::decodeReply, this, _1));
+    }
+}
 
-        /// Build a packet
-        packet_t packet = serial->encoder(list_send);
-        /// Receive information
-        vector<packet_information_t> receive = serial->parsing(serial->sendSyncPacket(packet));
-        /// Decode all messages
-        for (vector<packet_information_t>::iterator list_iter = receive.begin(); list_iter != receive.end(); ++list_iter) {
-            packet_information_t packet = (*list_iter);
-            switch (packet.option) {
-            case PACKET_NACK:
-                ///< Send a message ERROR
-                break;
-            case PACKET_DATA:
-                if (packet.type == HASHMAP_MOTOR) {
-                    if(packet.command = command_.command_message) {
-                        /// Set paramater
-                        setParam(packet.message.motor.parameter);
-                    }
-                }
-                break;
-            }
-        }
-    } else {
-        /// Send configuration to board
-        sendToSerial(getParam());
+void MotorParamConfigurator::decodeReply(const packet_information_t& packet) {
+    switch (packet.option) {
+    case PACKET_NACK:
+        ///< Send a message ERROR
+        break;
+    case PACKET_DATA:
+        /// Set paramater
+        setParam(packet.message.motor.parameter);
+        shadow_->confirm(HASHMAP_MOTOR, command_.command_message, &packet.message.motor.parameter, sizeof(motor_parameter_t));
+        cache_->store(nh_, name_);
+        break;
     }
+}
 
+void MotorParamConfigurator::initialize() {
     //Load dynamic reconfigure
     dsrv_ = new dynamic_reconfigure::Server<orbus_interface::UnavParameterConfig>(ros::NodeHandle("~" + name_));
     dynamic_reconfigure::Server<orbus_interface::UnavParameterConfig>::CallbackType cb = boost::bind(&MotorParamConfigurator::reconfigureCB, this, _1, _2);
     dsrv_->setCallback(cb);
 }
 
-
 void MotorParamConfigurator::setParam(motor_parameter_t parameter) {
     motor_parameter_encoder_t encoder = parameter.encoder;
     motor_parameter_bridge_t bridge = parameter.bridge;
@@ -100,13 +102,14 @@ motor_parameter_t MotorParamConfigurator::getParam() {
     motor_parameter_t parameter;
     int temp_int;
     double temp_double;
+    memset(&parameter, 0, sizeof(parameter));
     nh_.getParam(name_ + "/CPR", temp_int);
     parameter.encoder.cpr = (uint16_t) temp_int;
     nh_.getParam(name_ + "/Ratio", temp_double);
     parameter.ratio = (float) temp_double;
     /// Convert from mV in V
     nh_.getParam(name_ + "/Bridge", temp_double);
-    parameter.bridge.volt = (uint16_t) temp_double*1000;
+    parameter.bridge.volt = (int16_t) (temp_double*1000);
     nh_.getParam(name_ + "/Encoder", temp_int);
     parameter.encoder.position = (uint8_t) temp_int;
     nh_.getParam(name_ + "/Rotation", temp_int);
@@ -116,18 +119,10 @@ motor_parameter_t MotorParamConfigurator::getParam() {
     return parameter;
 }
 
-void MotorParamConfigurator::sendToSerial(motor_parameter_t parameter) {
-    packet_t packet_send = serial_->encoder(serial_->createDataPacket(command_.command_message, HASHMAP_MOTOR, (message_abstract_u*) & parameter));
-    try {
-        serial_->sendSyncPacket(packet_send, 3, boost::posix_time::millisec(200));
-    } catch (exception &e) {
-        ROS_ERROR("%s", e.what());
-    }
-}
-
-void MotorParamConfigurator::reconfigureCB(orbus_interface::UnavParameterConfig &config, uint32_t level) {
+void MotorParamConfigurator::reconfigureCB(orbus_interface::UnavParameterConfig &config, uint32_t) {
 
     motor_parameter_t param;
+    memset(&param, 0, sizeof(param));
     param.encoder.cpr = (uint16_t) config.CPR;
     param.bridge.enable = (uint8_t) config.Enable;
     param.encoder.position = (uint8_t) config.Encoder;
@@ -150,7 +145,7 @@ void MotorParamConfigurator::reconfigureCB(orbus_interface::UnavParameterConfig
       //if someone sets restore defaults on the parameter server, prevent looping
       config.restore_defaults = false;
     }
-    /// Send to serial
-    sendToSerial(param);
+    /// Sent by the next diagnostic tick, only if different from the board
+    shadow_->stage(HASHMAP_MOTOR, command_.command_message, &param, sizeof(param));
     last_param_ = param;
 }
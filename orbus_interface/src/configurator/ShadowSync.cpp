@@ -0,0 +1,176 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#include "configurator/ShadowSync.h"
+
+#include <string.h>
+
+using namespace std;
+
+namespace
+{
+  unsigned int key(unsigned char type, unsigned char command) {
+      return (type << 8) | command;
+  }
+}
+
+ShadowSync::ShadowSync(ParserPacket* serial, SerialExecutor* executor)
+: serial_(serial), executor_(executor), posting_(false), lost_(0) {
+}
+
+ShadowSync::entry_t& ShadowSync::entry(unsigned char type, unsigned char command, size_t length) {
+    shadow_map_t::iterator it = shadow_.find(key(type, command));
+    if (it == shadow_.end()) {
+        entry_t entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.type = type;
+        entry.command = command;
+        entry.length = length;
+        it = shadow_.insert(make_pair(key(type, command), entry)).first;
+    }
+    return it->second;
+}
+
+void ShadowSync::stage(unsigned char type, unsigned char command, const void* data, size_t length) {
+    boost::mutex::scoped_lock lock(mutex_);
+    entry_t& shadow = entry(type, command, length);
+    memcpy(&shadow.pending, data, length);
+    shadow.staged = true;
+}
+
+void ShadowSync::confirm(unsigned char type, unsigned char command, const void* data, size_t length) {
+    boost::mutex::scoped_lock lock(mutex_);
+    entry_t& shadow = entry(type, command, length);
+    memcpy(&shadow.confirmed, data, length);
+    shadow.valid = true;
+}
+
+void ShadowSync::acknowledged(unsigned char type, unsigned char command, boost::function<void ()> callback) {
+    boost::mutex::scoped_lock lock(mutex_);
+    acknowledged_[key(type, command)] = callback;
+}
+
+void ShadowSync::read(StartupPlanner* planner, unsigned char type, unsigned char command, size_t length) {
+    planner->add(serial_->createPacket(command, PACKET_REQUEST, type),
+                 boost::bind(&ShadowSync::readReply, this, type, command, length, _1));
+}
+
+void ShadowSync::collect(StartupPlanner* planner) {
+    boost::mutex::scoped_lock lock(mutex_);
+    for (shadow_map_t::iterator it = shadow_.begin(); it != shadow_.end(); ++it) {
+        entry_t& shadow = it->second;
+        if (!shadow.staged)
+            continue;
+        /// The board has already this value
+        if (shadow.valid && memcmp(&shadow.confirmed, &shadow.pending, shadow.length) == 0) {
+            shadow.staged = false;
+            continue;
+        }
+        planner->add(serial_->createDataPacket(shadow.command, shadow.type, &shadow.pending),
+                     boost::bind(&ShadowSync::writeReply, this, shadow.type, shadow.command, shadow.pending, _1));
+    }
+}
+
+unsigned int ShadowSync::flush() {
+    StartupPlanner planner(serial_, executor_);
+    collect(&planner);
+    if (planner.size() == 0)
+        return 0;
+    /// Values without answer stay staged for the next flush
+    lost_ += planner.run();
+    return planner.size();
+}
+
+unsigned int ShadowSync::post() {
+    /// Never two posts of the same values
+    if (posting_.exchange(true))
+        return 0;
+    boost::shared_ptr<StartupPlanner> planner(new StartupPlanner(serial_, executor_));
+    collect(planner.get());
+    unsigned int number = planner->size();
+    if (number == 0) {
+        posting_ = false;
+        return 0;
+    }
+    /// The planner lives until the answers are dispatched
+    planner->post(boost::bind(&ShadowSync::posted, this, planner, _1));
+    return number;
+}
+
+void ShadowSync::posted(boost::shared_ptr<StartupPlanner>, unsigned int lost) {
+    lost_ += lost;
+    posting_ = false;
+}
+
+unsigned int ShadowSync::staged() {
+    boost::mutex::scoped_lock lock(mutex_);
+    unsigned int number = 0;
+    for (shadow_map_t::iterator it = shadow_.begin(); it != shadow_.end(); ++it) {
+        if (it->second.staged)
+            number++;
+    }
+    return number;
+}
+
+void ShadowSync::readReply(unsigned char type, unsigned char command, size_t length, const packet_information_t& packet) {
+    if (packet.option == PACKET_DATA)
+        confirm(type, command, &packet.message, length);
+}
+
+void ShadowSync::writeReply(unsigned char type, unsigned char command, message_abstract_u sent, const packet_information_t& packet) {
+    boost::function<void ()> callback;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        entry_t& shadow = entry(type, command, sizeof(sent));
+        bool same = memcmp(&shadow.pending, &sent, shadow.length) == 0;
+        switch (packet.option) {
+        case PACKET_ACK:
+            memcpy(&shadow.confirmed, &sent, shadow.length);
+            shadow.valid = true;
+            /// A newer value staged in the meantime is still sent, and acknowledged later
+            if (same) {
+                shadow.staged = false;
+                callback_map_t::iterator it = acknowledged_.find(key(type, command));
+                if (it != acknowledged_.end())
+                    callback = it->second;
+            }
+            break;
+        case PACKET_NACK:
+            /// Refused by the board, never sent again
+            if (same)
+                shadow.staged = false;
+            break;
+        }
+    }
+    if (callback)
+        callback();
+}
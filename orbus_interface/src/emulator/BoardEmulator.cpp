@@ -0,0 +1,338 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#include "emulator/BoardEmulator.h"
+
+#include <math.h>
+#include <string.h>
+
+using namespace std;
+
+namespace
+{
+  /// Velocities and positions travel in thousandths
+  int16_t toBoard(double value) {
+      double scaled = floor(value * 1000 + 0.5);
+      if (scaled > 32767)
+          return 32767;
+      if (scaled < -32768)
+          return -32768;
+      return (int16_t) scaled;
+  }
+
+  /// Copy at most the size of the structure
+  void copyPayload(void* destination, size_t size, const unsigned char* payload, size_t length) {
+      memcpy(destination, payload, length < size ? length : size);
+  }
+}
+
+BoardEmulator::BoardEmulator(const options_t& options)
+: options_(options), state_(WAIT_HEADER), header_(0), length_(0), frames_(0), errors_(0) {
+    memset(motors_, 0, sizeof(motors_));
+    for (unsigned int i = 0; i < EMULATOR_MOTORS; ++i) {
+        motors_[i].pid.kp = 1.0;
+        motors_[i].parameter.encoder.cpr = 1000;
+        motors_[i].parameter.ratio = 1.0;
+        motors_[i].parameter.bridge.volt = 12000;
+        motors_[i].parameter.bridge.enable = 1;
+        motors_[i].emergency.slope_time = 1.0;
+        motors_[i].emergency.bridge_off = 2.0;
+        motors_[i].emergency.timeout = 500;
+        motors_[i].constraint.velocity = -1;
+    }
+    data_.reserve(256);
+}
+
+void BoardEmulator::receive(const unsigned char* data, size_t length, std::vector<unsigned char>* reply) {
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char byte = data[i];
+        switch (state_) {
+        case WAIT_HEADER:
+            if (byte == ORBUS_HEADER_SYNC || byte == ORBUS_HEADER_ASYNC) {
+                header_ = byte;
+                state_ = WAIT_LENGTH;
+            }
+            break;
+        case WAIT_LENGTH:
+            if (byte == 0 || byte > ORBUS_MAX_DATA) {
+                errors_++;
+                state_ = WAIT_HEADER;
+                break;
+            }
+            length_ = byte;
+            data_.clear();
+            state_ = WAIT_DATA;
+            break;
+        case WAIT_DATA:
+            data_.push_back(byte);
+            if (data_.size() == length_)
+                state_ = WAIT_CHECKSUM;
+            break;
+        case WAIT_CHECKSUM: {
+            unsigned char checksum = 0;
+            for (size_t j = 0; j < data_.size(); ++j)
+                checksum += data_[j];
+            if (checksum == byte)
+                decodeFrame(header_, &data_[0], data_.size(), reply);
+            else
+                errors_++;
+            state_ = WAIT_HEADER;
+            break;
+        }
+        }
+    }
+}
+
+void BoardEmulator::decodeFrame(unsigned char header, const unsigned char* data, size_t length, std::vector<unsigned char>* reply) {
+    vector<unsigned char> messages;
+    size_t offset = 0;
+    while (offset + ORBUS_MESSAGE_HEAD <= length) {
+        size_t size = data[offset];
+        if (size < ORBUS_MESSAGE_HEAD || offset + size > length) {
+            errors_++;
+            return;
+        }
+        decodeMessage(data[offset + 1], data[offset + 2], data[offset + 3],
+                      &data[offset + ORBUS_MESSAGE_HEAD], size - ORBUS_MESSAGE_HEAD, &messages);
+        offset += size;
+    }
+    frames_++;
+    appendFrame(header, messages, reply);
+}
+
+void BoardEmulator::decodeMessage(unsigned char option, unsigned char type, unsigned char command,
+                                  const unsigned char* payload, size_t length, std::vector<unsigned char>* messages) {
+    switch (type) {
+    case HASHMAP_SYSTEM:
+        decodeSystem(option, command, payload, length, messages);
+        break;
+    case HASHMAP_MOTOR:
+        decodeMotor(option, command, payload, length, messages);
+        break;
+    default:
+        appendMessage(PACKET_NACK, type, command, NULL, 0, messages);
+        break;
+    }
+}
+
+void BoardEmulator::decodeSystem(unsigned char option, unsigned char command, const unsigned char* payload, size_t length,
+                                 std::vector<unsigned char>* messages) {
+    switch (command) {
+    case SYSTEM_SERVICE: {
+        /// The code of the service is the payload of a data message
+        if (option != PACKET_DATA) {
+            appendMessage(PACKET_NACK, HASHMAP_SYSTEM, command, NULL, 0, messages);
+            break;
+        }
+        system_service_t service;
+        memset(&service, 0, sizeof(service));
+        copyPayload(&service, sizeof(service), payload, length);
+        string answer;
+        switch (service.command) {
+        case SERVICE_CODE_VERSION:
+            answer = options_.version;
+            break;
+        case SERVICE_CODE_AUTHOR:
+            answer = options_.author;
+            break;
+        case SERVICE_CODE_BOARD_NAME:
+            answer = options_.name;
+            break;
+        case SERVICE_CODE_DATE:
+            answer = options_.date;
+            break;
+        case SERVICE_CODE_BOARD_TYPE:
+            answer = options_.type;
+            break;
+        case SERVICE_RESET:
+            for (unsigned int i = 0; i < EMULATOR_MOTORS; ++i) {
+                motors_[i].reference = motors_[i].velocity = 0;
+                motors_[i].position = motors_[i].position_sent = 0;
+            }
+            appendMessage(PACKET_ACK, HASHMAP_SYSTEM, command, NULL, 0, messages);
+            return;
+        default:
+            appendMessage(PACKET_NACK, HASHMAP_SYSTEM, command, NULL, 0, messages);
+            return;
+        }
+        memset(service.buffer, 0, sizeof(service.buffer));
+        strncpy((char*) service.buffer, answer.c_str(), sizeof(service.buffer) - 1);
+        appendMessage(PACKET_DATA, HASHMAP_SYSTEM, command, &service, sizeof(service), messages);
+        break;
+    }
+    case SYSTEM_SERIAL_ERROR: {
+        /// Read only
+        if (option != PACKET_REQUEST) {
+            appendMessage(PACKET_NACK, HASHMAP_SYSTEM, command, NULL, 0, messages);
+            break;
+        }
+        system_error_serial_t error;
+        memset(&error, 0, sizeof(error));
+        appendMessage(PACKET_DATA, HASHMAP_SYSTEM, command, &error, sizeof(error), messages);
+        break;
+    }
+    default:
+        appendMessage(PACKET_NACK, HASHMAP_SYSTEM, command, NULL, 0, messages);
+        break;
+    }
+}
+
+void BoardEmulator::decodeMotor(unsigned char option, unsigned char command, const unsigned char* payload, size_t length,
+                                std::vector<unsigned char>* messages) {
+    motor_command_map_t motor_command;
+    motor_command.command_message = command;
+    if (motor_command.bitset.motor >= EMULATOR_MOTORS) {
+        appendMessage(PACKET_NACK, HASHMAP_MOTOR, command, NULL, 0, messages);
+        return;
+    }
+    motor_emulator_t& motor = motors_[motor_command.bitset.motor];
+    bool request = (option == PACKET_REQUEST);
+    switch (motor_command.bitset.command) {
+    case MOTOR_MEASURE: {
+        motor_t measure;
+        memset(&measure, 0, sizeof(measure));
+        measure.position = toBoard(motor.position);
+        measure.velocity = toBoard(motor.velocity);
+        measure.torque = toBoard((motor.reference - motor.velocity) * motor.pid.kp);
+        /// Position moved from the last measure, the rest is sent with the next one
+        measure.position_delta = toBoard(motor.position - motor.position_sent);
+        motor.position_sent += measure.position_delta / 1000.0;
+        appendMessage(PACKET_DATA, HASHMAP_MOTOR, command, &measure, sizeof(measure), messages);
+        return;
+    }
+    case MOTOR_VEL_REF:
+        if (request) {
+            motor_control_t reference = toBoard(motor.reference);
+            appendMessage(PACKET_DATA, HASHMAP_MOTOR, command, &reference, sizeof(reference), messages);
+            return;
+        } else {
+            motor_control_t reference = 0;
+            copyPayload(&reference, sizeof(reference), payload, length);
+            motor.reference = reference / 1000.0;
+            motor.reference_age = 0;
+        }
+        break;
+    case MOTOR_PARAMETER:
+        if (request) {
+            appendMessage(PACKET_DATA, HASHMAP_MOTOR, command, &motor.parameter, sizeof(motor.parameter), messages);
+            return;
+        }
+        copyPayload(&motor.parameter, sizeof(motor.parameter), payload, length);
+        break;
+    case MOTOR_VEL_PID:
+        if (request) {
+            appendMessage(PACKET_DATA, HASHMAP_MOTOR, command, &motor.pid, sizeof(motor.pid), messages);
+            return;
+        }
+        copyPayload(&motor.pid, sizeof(motor.pid), payload, length);
+        break;
+    case MOTOR_EMERGENCY:
+        if (request) {
+            appendMessage(PACKET_DATA, HASHMAP_MOTOR, command, &motor.emergency, sizeof(motor.emergency), messages);
+            return;
+        }
+        copyPayload(&motor.emergency, sizeof(motor.emergency), payload, length);
+        break;
+    case MOTOR_CONSTRAINT:
+        if (request) {
+            appendMessage(PACKET_DATA, HASHMAP_MOTOR, command, &motor.constraint, sizeof(motor.constraint), messages);
+            return;
+        }
+        copyPayload(&motor.constraint, sizeof(motor.constraint), payload, length);
+        break;
+    case MOTOR_POS_RESET:
+        motor.position = motor.position_sent = 0;
+        break;
+    case MOTOR_DIAGNOSTIC: {
+        motor_diagnostic_t diagnostic;
+        memset(&diagnostic, 0, sizeof(diagnostic));
+        diagnostic.volt = motor.parameter.bridge.volt;
+        diagnostic.current = toBoard(fabs(motor.reference - motor.velocity) * motor.pid.kp);
+        diagnostic.watt = (diagnostic.volt / 1000.0) * (diagnostic.current / 1000.0);
+        diagnostic.temperature = 25;
+        appendMessage(PACKET_DATA, HASHMAP_MOTOR, command, &diagnostic, sizeof(diagnostic), messages);
+        return;
+    }
+    case MOTOR_STATE:
+        if (request) {
+            appendMessage(PACKET_DATA, HASHMAP_MOTOR, command, &motor.state, sizeof(motor.state), messages);
+            return;
+        }
+        copyPayload(&motor.state, sizeof(motor.state), payload, length);
+        break;
+    default:
+        appendMessage(PACKET_NACK, HASHMAP_MOTOR, command, NULL, 0, messages);
+        return;
+    }
+    /// A write is acknowledged, a request of a write-only message is refused
+    appendMessage(request ? PACKET_NACK : PACKET_ACK, HASHMAP_MOTOR, command, NULL, 0, messages);
+}
+
+void BoardEmulator::step(double dt) {
+    for (unsigned int i = 0; i < EMULATOR_MOTORS; ++i) {
+        motor_emulator_t& motor = motors_[i];
+        motor.reference_age += dt;
+        /// Without references the board stops the motor
+        if (motor.emergency.timeout > 0 && motor.reference_age * 1000 > motor.emergency.timeout)
+            motor.reference = 0;
+        double reference = motor.reference;
+        if (motor.constraint.velocity > 0) {
+            double limit = motor.constraint.velocity / 1000.0;
+            reference = (reference > limit) ? limit : ((reference < -limit) ? -limit : reference);
+        }
+        if (!motor.parameter.bridge.enable)
+            reference = 0;
+        double alpha = (options_.time_constant > 0) ? dt / (options_.time_constant + dt) : 1.0;
+        motor.velocity += (reference - motor.velocity) * alpha;
+        motor.position += motor.velocity * dt;
+    }
+}
+
+void BoardEmulator::appendMessage(unsigned char option, unsigned char type, unsigned char command,
+                                  const void* payload, size_t size, std::vector<unsigned char>* messages) {
+    messages->push_back((unsigned char) (ORBUS_MESSAGE_HEAD + size));
+    messages->push_back(option);
+    messages->push_back(type);
+    messages->push_back(command);
+    const unsigned char* bytes = (const unsigned char*) payload;
+    messages->insert(messages->end(), bytes, bytes + size);
+}
+
+void BoardEmulator::appendFrame(unsigned char header, const std::vector<unsigned char>& messages, std::vector<unsigned char>* reply) {
+    unsigned char checksum = 0;
+    for (size_t i = 0; i < messages.size(); ++i)
+        checksum += messages[i];
+    reply->push_back(header);
+    reply->push_back((unsigned char) messages.size());
+    reply->insert(reply->end(), messages.begin(), messages.end());
+    reply->push_back(checksum);
+}
@@ -0,0 +1,85 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+
+#include "emulator/EmulatorLoop.h"
+
+EmulatorLoop::EmulatorLoop(BoardEmulator* board, PtyLink* link)
+: board_(board), link_(link), last_(clock_t::now()), running_(false) {
+    reply_.reserve(1024);
+}
+
+EmulatorLoop::~EmulatorLoop() {
+    stop();
+}
+
+bool EmulatorLoop::spinOnce() {
+    /// Wake up for the next answer, and at least every millisecond for the motors
+    int timeout = link_->nextWrite();
+    if (timeout < 0 || timeout > 1)
+        timeout = 1;
+    int length = link_->read(buffer_, sizeof(buffer_), timeout);
+    if (length < 0)
+        return false;
+
+    clock_t::time_point now = clock_t::now();
+    board_->step(boost::chrono::duration<double>(now - last_).count());
+    last_ = now;
+
+    if (length > 0) {
+        reply_.clear();
+        board_->receive(buffer_, length, &reply_);
+        link_->write(reply_);
+    }
+    link_->flush();
+    return true;
+}
+
+void EmulatorLoop::start() {
+    if (running_)
+        return;
+    running_ = true;
+    last_ = clock_t::now();
+    thread_ = boost::thread(&EmulatorLoop::run, this);
+}
+
+void EmulatorLoop::stop() {
+    if (!running_)
+        return;
+    running_ = false;
+    thread_.join();
+}
+
+void EmulatorLoop::run() {
+    while (running_ && spinOnce()) {
+    }
+}
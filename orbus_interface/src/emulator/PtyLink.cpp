@@ -0,0 +1,162 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#include "emulator/PtyLink.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace std;
+
+PtyLink::PtyLink(const impairment_t& impairment)
+: impairment_(impairment), master_(-1), slave_(-1), random_(impairment.seed), corrupted_(0), received_(0), sent_(0) {
+}
+
+PtyLink::~PtyLink() {
+    close();
+}
+
+bool PtyLink::open(const std::string& link) {
+    master_ = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master_ < 0 || grantpt(master_) != 0 || unlockpt(master_) != 0) {
+        close();
+        return false;
+    }
+    name_ = ptsname(master_);
+    /// The slave stays open: the master is never hung up when the driver closes the port
+    slave_ = ::open(name_.c_str(), O_RDWR | O_NOCTTY);
+    if (slave_ < 0) {
+        close();
+        return false;
+    }
+    struct termios options;
+    tcgetattr(slave_, &options);
+    cfmakeraw(&options);
+    tcsetattr(slave_, TCSANOW, &options);
+
+    if (!link.empty()) {
+        unlink(link.c_str());
+        if (symlink(name_.c_str(), link.c_str()) != 0) {
+            close();
+            return false;
+        }
+        link_ = link;
+    }
+    line_free_ = clock_t::now();
+    return true;
+}
+
+void PtyLink::close() {
+    if (!link_.empty()) {
+        unlink(link_.c_str());
+        link_.clear();
+    }
+    if (slave_ >= 0)
+        ::close(slave_);
+    if (master_ >= 0)
+        ::close(master_);
+    slave_ = master_ = -1;
+}
+
+int PtyLink::read(unsigned char* buffer, size_t size, int timeout_ms) {
+    struct pollfd fd;
+    fd.fd = master_;
+    fd.events = POLLIN;
+    int ready = poll(&fd, 1, timeout_ms);
+    if (ready < 0)
+        return (errno == EINTR) ? 0 : -1;
+    if (ready == 0)
+        return 0;
+    ssize_t length = ::read(master_, buffer, size);
+    if (length < 0)
+        return (errno == EINTR || errno == EAGAIN) ? 0 : -1;
+    received_ += length;
+    return (int) length;
+}
+
+void PtyLink::write(const std::vector<unsigned char>& data) {
+    if (data.empty())
+        return;
+    pending_t pending;
+    pending.data = data;
+    double delay = impairment_.latency + impairment_.jitter * uniform();
+    pending.due = clock_t::now() + boost::chrono::microseconds((long) (delay * 1000));
+    if (pending.due < line_free_)
+        pending.due = line_free_;
+    if (impairment_.baud > 0) {
+        /// 10 bits for every byte: start, 8 data and stop
+        pending.due += boost::chrono::microseconds((long) (data.size() * 10 * 1e6 / impairment_.baud));
+    }
+    line_free_ = pending.due;
+    for (size_t i = 0; i < pending.data.size(); ++i) {
+        if (impairment_.corruption > 0 && uniform() < impairment_.corruption) {
+            pending.data[i] ^= (unsigned char) (1 << (rand_r(&random_) % 8));
+            corrupted_++;
+        }
+    }
+    queue_.push_back(pending);
+}
+
+void PtyLink::flush() {
+    clock_t::time_point now = clock_t::now();
+    while (!queue_.empty() && queue_.front().due <= now) {
+        const vector<unsigned char>& data = queue_.front().data;
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t length = ::write(master_, &data[sent], data.size() - sent);
+            if (length < 0) {
+                if (errno == EINTR || errno == EAGAIN)
+                    continue;
+                break;
+            }
+            sent += length;
+        }
+        sent_ += sent;
+        queue_.pop_front();
+    }
+}
+
+int PtyLink::nextWrite() {
+    if (queue_.empty())
+        return -1;
+    clock_t::duration wait = queue_.front().due - clock_t::now();
+    long ms = boost::chrono::duration_cast<boost::chrono::milliseconds>(wait).count();
+    return (ms > 0) ? (int) ms : 0;
+}
+
+double PtyLink::uniform() {
+    return rand_r(&random_) / (RAND_MAX + 1.0);
+}
@@ -0,0 +1,129 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#include "emulator/EmulatorLoop.h"
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace
+{
+  volatile sig_atomic_t running = 1;
+
+  void stop(int) {
+      running = 0;
+  }
+
+  void usage(const char* name) {
+      fprintf(stderr,
+              "Usage: %s [options]\n"
+              "  --link PATH        symbolic link to the pseudo-terminal, e.g. /tmp/unav\n"
+              "  --latency MS       delay of every answer\n"
+              "  --jitter MS        random delay added to the latency\n"
+              "  --baud RATE        emulated baud rate, 0 without limit\n"
+              "  --corruption P     probability of every byte sent to be corrupted\n"
+              "  --time-constant S  time constant of the motors\n"
+              "  --seed N           seed of jitter and corruption\n", name);
+  }
+}
+
+/**
+* Emulator of a µNAV board on a pseudo-terminal: hardware_unav runs with
+* serial_port set to the name printed on the standard output.
+*/
+int main(int argc, char **argv) {
+    BoardEmulator::options_t options;
+    PtyLink::impairment_t impairment;
+    std::string link;
+
+    static struct option long_options[] = {
+        {"link", required_argument, NULL, 'l'},
+        {"latency", required_argument, NULL, 'L'},
+        {"jitter", required_argument, NULL, 'j'},
+        {"baud", required_argument, NULL, 'b'},
+        {"corruption", required_argument, NULL, 'c'},
+        {"time-constant", required_argument, NULL, 't'},
+        {"seed", required_argument, NULL, 's'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "l:L:j:b:c:t:s:h", long_options, NULL)) != -1) {
+        switch (option) {
+        case 'l':
+            link = optarg;
+            break;
+        case 'L':
+            impairment.latency = atof(optarg);
+            break;
+        case 'j':
+            impairment.jitter = atof(optarg);
+            break;
+        case 'b':
+            impairment.baud = atoi(optarg);
+            break;
+        case 'c':
+            impairment.corruption = atof(optarg);
+            break;
+        case 't':
+            options.time_constant = atof(optarg);
+            break;
+        case 's':
+            impairment.seed = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return (option == 'h') ? 0 : 1;
+        }
+    }
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+
+    PtyLink pty(impairment);
+    if (!pty.open(link)) {
+        perror("Cannot open the pseudo-terminal");
+        return 1;
+    }
+    /// The name for the driver, alone on the standard output
+    printf("%s\n", pty.name().c_str());
+    fflush(stdout);
+
+    BoardEmulator board(options);
+    EmulatorLoop loop(&board, &pty);
+    while (running && loop.spinOnce()) {
+    }
+    fprintf(stderr, "Frames: %u errors: %u corrupted bytes: %u\n", board.frames(), board.errors(), pty.corrupted());
+    return 0;
+}
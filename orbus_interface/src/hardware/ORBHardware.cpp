@@ -30,13 +30,16 @@
 */
 
 #include "hardware/ORBHardware.h"
+#include "realtime/Tracer.h"
+
+#include <stdio.h>
 
 using namespace std;
 
 #define NUMBER_PUB 10
 
 ORBHardware::ORBHardware(const ros::NodeHandle& nh, const ros::NodeHandle &private_nh, ParserPacket* serial)
-: nh_(nh), private_nh_(private_nh), serial_(serial), init_number_process(false), name_board_("Nothing"), type_board_("Nothing") {
+: nh_(nh), private_nh_(private_nh), serial_(serial), window_(NULL), executor_(serial, &policy_), shadow_(serial, &executor_), diagnostic_(nh, private_nh), name_board_("Nothing"), type_board_("Nothing"), init_number_process(false), nacks_(0), tick_sent_(0), tick_received_(0), stamp_late_(0), stamp_early_(0), serial_timeouts_(0) {
     serial_->addCallback(&ORBHardware::defaultPacket, this);
     serial_->addErrorCallback(&ORBHardware::errorPacket, this);
 
@@ -47,26 +50,71 @@ ORBHardware::ORBHardware(const ros::NodeHandle& nh, const ros::NodeHandle &priva
     //srv_board = nh_.advertiseService("service_serial", &ORBHardware::service_Callback, this);
     //srv_process = nh_.advertiseService("process", &ORBHardware::processServiceCallback, this);
 
+    /// Control transactions must end inside the control period
+    double control_frequency;
+    int control_repeat, config_repeat, config_timeout;
+    private_nh_.param<double>("control_frequency", control_frequency, 10.0);
+    private_nh_.param<double>("transaction/control_ratio", control_ratio_, 0.8);
+    private_nh_.param<int>("transaction/control_repeat", control_repeat, 1);
+    private_nh_.param<int>("transaction/config_repeat", config_repeat, 3);
+    private_nh_.param<int>("transaction/config_timeout", config_timeout, 200);
+    policy_.setControl(1.0 / control_frequency, control_ratio_, control_repeat);
+    policy_.setConfiguration(config_repeat, config_timeout);
+    loop_.setFrequency(control_frequency);
+    /// The measures of a cycle are stale after three periods
+    private_nh_.param<double>("measure_max_delay", measure_max_delay_, 3.0 / control_frequency);
+    private_nh_.param<double>("serial_rate", serial_rate_, 115200);
+
     map_error_serial[ERROR_TIMEOUT_SYNC_PACKET_STRING] = 0;
     map_error_serial[ERROR_MAX_ASYNC_CALLBACK_STRING] = 0;
 
+    diagnostic_.add("Control loop", this, &ORBHardware::loopDiagnostics);
+    diagnostic_.add("Serial link", this, &ORBHardware::linkDiagnostics);
+    /// Only a build with ORBUS_COUNT_ALLOCATIONS counts them
+    if (AllocationCounter::enabled())
+        diagnostic_.add("Control loop allocations", this, &ORBHardware::allocationDiagnostics);
+    diagnostic_.add("Serial round trip", this, &ORBHardware::latencyDiagnostics);
+
+    /// Number of requests in flight, 0 keeps the stop-and-wait transactions
+    int pipeline_window;
+    private_nh_.param<int>("pipeline_window", pipeline_window, 0);
+    if (pipeline_window > 0) {
+        ROS_INFO("Pipelined requests, window: %d", pipeline_window);
+        window_ = new PacketWindow(serial_, &executor_, pipeline_window);
+    }
+}
+
+void ORBHardware::start() {
+    /// From now on, every frame is sent by the executor
+    executor_.start();
+
     vector<packet_information_t> list_packet;
     list_packet.push_back(encodeServices(SERVICE_CODE_VERSION));
     list_packet.push_back(encodeServices(SERVICE_CODE_AUTHOR));
     list_packet.push_back(encodeServices(SERVICE_CODE_BOARD_NAME));
     list_packet.push_back(encodeServices(SERVICE_CODE_DATE));
     list_packet.push_back(encodeServices(SERVICE_CODE_BOARD_TYPE));
-    serial->parserSendPacket(list_packet);
+    executor_.execute(TransactionPolicy::CONFIGURATION, serial_->encoder(list_packet));
+
+    /// Configuration of the last launch, if the firmware is the same
+    bool config_cache;
+    private_nh_.param<bool>("config_cache", config_cache, true);
+    if (config_cache)
+        cache_.open(name_board_, type_board_, version_, std::string(compiled_.c_str()));
+
+    diagnostic_.setHardwareID(name_board_);
 }
 
 ORBHardware::~ORBHardware() {
+    executor_.stop();
     serial_->clearCallback();
     serial_->clearErrorCallback();
+    delete window_;
 }
 
 void ORBHardware::loadParameter() {
-    // Build a list of packets
-    vector<packet_information_t> list_packet;
+    /// All queries and writes of the startup, in the fewest frames
+    StartupPlanner planner(serial_, &executor_);
 
 
     //Name process
@@ -114,13 +162,16 @@ void ORBHardware::loadParameter() {
 //    }
     //Add other parameter request
     if (callback_add_parameter)
-        callback_add_parameter(&list_packet);
-    try {
-        ROS_INFO("Sync parameters");
-        serial_->parserSendPacket(list_packet, 3, boost::posix_time::millisec(200));
-    } catch (exception &e) {
-        ROS_ERROR("%s", e.what());
-    }
+        callback_add_parameter(&planner);
+    ROS_INFO("Sync parameters: %zu messages", planner.size());
+    unsigned int lost = planner.run();
+    if (lost > 0)
+        ROS_ERROR("Sync parameters: %u messages without answer", lost);
+    /// Write only the configuration different from the board, all motors in one frame
+    unsigned int written = shadow_.flush();
+    ROS_INFO("Sync parameters: %u configurations written", written);
+    /// Save what is read from the board for the next launch
+    cache_.save();
 }
 
 /**
@@ -128,7 +179,11 @@ void ORBHardware::loadParameter() {
 */
 void ORBHardware::updateDiagnostics()
 {
-
+    /// Reconfigure changes of all motors since the last tick, in one exchange
+    shadow_.post();
+    /// Save the configurations acknowledged by the board since the last tick
+    cache_.save();
+    diagnostic_.force_update();
 }
 
 /**
@@ -136,10 +191,193 @@ void ORBHardware::updateDiagnostics()
 */
 void ORBHardware::reportLoopDuration(const ros::Duration &duration)
 {
+    /// A new cycle starts, the serial budget starts again
+    policy_.startCycle();
+    loop_.period(duration.toNSec());
+}
+
+void ORBHardware::reportCycleDuration(const ros::Duration &duration)
+{
+    loop_.cycle(duration.toNSec());
+}
+
+void ORBHardware::reportAllocations(loop_phase_t phase, const AllocationCounter::sample_t& sample) {
+    allocation_stats_t& stats = allocations_[phase];
+    stats.ticks++;
+    stats.count += sample.count;
+    stats.bytes += sample.bytes;
+    unsigned long max = stats.max.load(boost::memory_order_relaxed);
+    while (sample.count > max && !stats.max.compare_exchange_weak(max, sample.count, boost::memory_order_relaxed)) {
+    }
+}
+
+void ORBHardware::allocationDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status) {
+    const char* names[LOOP_PHASES] = {"read", "update", "write"};
+    bool clean = true;
+    for (unsigned int i = 0; i < LOOP_PHASES; ++i) {
+        unsigned long ticks = allocations_[i].ticks.exchange(0);
+        unsigned long count = allocations_[i].count.exchange(0);
+        unsigned long bytes = allocations_[i].bytes.exchange(0);
+        unsigned long max = allocations_[i].max.exchange(0);
+        std::string name(names[i]);
+        status.addf(name + " allocations/tick", "%.2f", (ticks > 0) ? (double) count / ticks : 0.0);
+        status.addf(name + " bytes/tick", "%.1f", (ticks > 0) ? (double) bytes / ticks : 0.0);
+        status.addf(name + " max allocations", "%lu", max);
+        clean = clean && (count == 0);
+    }
+    if (clean)
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "No allocations in the control loop");
+    else
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Allocations in the control loop");
+}
+
+void ORBHardware::loopDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status) {
+    LoopMonitor::stats_t stats = loop_.collect();
+    double frequency = (stats.window > 0) ? stats.cycles / stats.window : 0.0;
+    double target = loop_.frequency();
+    /// The keys of diagnostic_updater::FrequencyStatus
+    status.addf("Events in window", "%lu", stats.cycles);
+    status.addf("Events since startup", "%lu", loop_.total());
+    status.addf("Duration of window (s)", "%f", stats.window);
+    status.addf("Actual frequency (Hz)", "%f", frequency);
+    status.addf("Target frequency (Hz)", "%f", target);
+    status.addf("Overruns", "%lu", stats.overruns);
+    status.addf("Period jitter mean (us)", "%.1f", stats.jitter_mean);
+    status.addf("Period jitter max (us)", "%.0f", stats.jitter_max);
+    status.addf("Cycle time mean (us)", "%.1f", stats.cycle_mean);
+    status.addf("Cycle time max (us)", "%.0f", stats.cycle_max);
+    status.addf("Time since last cycle (s)", "%f", stats.since_last);
+    if (stats.cycles == 0)
+        status.summary(diagnostic_msgs::DiagnosticStatus::ERROR, "No control cycle");
+    else if (frequency < 0.9 * target)
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Frequency too low");
+    else if (frequency > 1.1 * target)
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Frequency too high");
+    else if (stats.overruns > 0)
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Missed deadlines");
+    else if (target > 0 && stats.cycle_max > 1e6 / target)
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Cycle longer than the period");
+    else
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Desired frequency met");
+
+    /// The keys of diagnostic_updater::TimeStampStatus, for the measures used by the cycles
+    bool late = stats.stamps > 0 && stats.delay_max > measure_max_delay_;
+    bool early = stats.stamps > 0 && stats.delay_min < 0;
+    if (late)
+        stamp_late_++;
+    if (early)
+        stamp_early_++;
+    status.addf("Earliest timestamp delay:", "%f", (stats.stamps > 0) ? stats.delay_min : 0.0);
+    status.addf("Latest timestamp delay:", "%f", (stats.stamps > 0) ? stats.delay_max : 0.0);
+    status.addf("Earliest acceptable timestamp delay:", "%f", 0.0);
+    status.addf("Latest acceptable timestamp delay:", "%f", measure_max_delay_);
+    status.addf("Late diagnostic update count:", "%lu", stamp_late_);
+    status.addf("Early diagnostic update count:", "%lu", stamp_early_);
+    if (late)
+        status.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "Timestamps too far in past seen.");
+    else if (early)
+        status.mergeSummary(diagnostic_msgs::DiagnosticStatus::ERROR, "Timestamps too far in future seen.");
+    else if (stats.cycles > 0 && stats.stamps == 0)
+        status.mergeSummary(diagnostic_msgs::DiagnosticStatus::WARN, "No measures since last update.");
+}
+
+void ORBHardware::linkDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status) {
+    boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+    double window = boost::chrono::duration<double>(now - link_.time).count();
+    if (window <= 0)
+        return;
+    unsigned long sent = executor_.sent();
+    unsigned long received = executor_.received();
+    /// 8N1, ten bits on the line for every byte
+    double bytes_per_second = serial_rate_ / 10.0;
+    double tx = (sent - link_.sent) / window;
+    double rx = (received - link_.received) / window;
+    status.addf("Sent (byte/s)", "%.0f", tx);
+    status.addf("Received (byte/s)", "%.0f", rx);
+    status.addf("Utilisation TX (%)", "%.1f", 100.0 * tx / bytes_per_second);
+    status.addf("Utilisation RX (%)", "%.1f", 100.0 * rx / bytes_per_second);
+    unsigned long sent_frames = executor_.sentFrames();
+    unsigned long received_frames = executor_.receivedFrames();
+    status.addf("Frames sent (1/s)", "%.1f", (sent_frames - link_.sent_frames) / window);
+    status.addf("Frames received (1/s)", "%.1f", (received_frames - link_.received_frames) / window);
+    /// Expected from the frames of a control tick
+    status.addf("Expected bytes/tick", "%.0f sent, %.0f received", tick_sent_, tick_received_);
+    status.addf("Expected utilisation (%)", "%.1f",
+                100.0 * (tick_sent_ + tick_received_) * loop_.frequency() / bytes_per_second);
+    for (unsigned int i = 0; i < executor_.commands(); ++i) {
+        const SerialExecutor::command_stats_t& stats = executor_.command(i);
+        unsigned long command_sent = stats.sent, command_received = stats.received;
+        char name[48];
+        snprintf(name, sizeof(name), "%c %u (byte/s)", stats.hashmap, stats.command);
+        status.addf(name, "%.0f sent, %.0f received", (command_sent - link_.command_sent[i]) / window,
+                    (command_received - link_.command_received[i]) / window);
+        link_.command_sent[i] = command_sent;
+        link_.command_received[i] = command_received;
+    }
 
+    /// Errors counted by ParserPacket, NACKs of the board, transactions refused and configurations lost
+    unsigned long errors = nacks_ + executor_.overflows() + shadow_.lost();
+    status.addf("NACK", "%lu", (unsigned long) nacks_);
+    status.addf("Transactions refused, executor full", "%lu", executor_.overflows());
+    status.addf("Configurations without answer", "%lu", shadow_.lost());
+    map<string, int> map_error = serial_->getMapError();
+    for (map<string, int>::iterator ii = map_error.begin(); ii != map_error.end(); ++ii) {
+        status.addf(ii->first, "%d", ii->second);
+        errors += ii->second;
+    }
+    double error_rate = (errors - link_.errors) / window;
+    status.addf("Errors (1/s)", "%.2f", error_rate);
+
+    if (error_rate > 0)
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Serial errors");
+    else if (tx > 0.9 * bytes_per_second || rx > 0.9 * bytes_per_second)
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Serial link saturated");
+    else
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Serial link OK");
+    link_.time = now;
+    link_.sent = sent;
+    link_.received = received;
+    link_.errors = errors;
+    link_.sent_frames = sent_frames;
+    link_.received_frames = received_frames;
+}
+
+void ORBHardware::setTickTraffic(double sent, double received) {
+    tick_sent_ = sent;
+    tick_received_ = received;
+    /// 8N1, and every transaction waits its answer: requests and answers share the period
+    double airtime = (sent + received) * 10.0 / serial_rate_;
+    double budget = control_ratio_ / loop_.frequency();
+    if (airtime > budget) {
+        ROS_WARN("control_frequency %.1f Hz does not fit on the serial link: %.0f bytes every tick take %.1f ms at %.0f baud, "
+                 "the budget is %.1f ms. Highest control_frequency: %.1f Hz",
+                 loop_.frequency(), sent + received, airtime * 1000, serial_rate_, budget * 1000, control_ratio_ / airtime);
+    } else {
+        ROS_INFO("Serial link: %.0f bytes sent and %.0f received every tick, %.0f%% of the budget",
+                 sent, received, 100.0 * airtime / budget);
+    }
+}
+
+void ORBHardware::latencyDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status) {
+    unsigned long timeouts = 0;
+    for (unsigned int i = 0; i < executor_.commands(); ++i) {
+        const SerialExecutor::command_stats_t& stats = executor_.command(i);
+        char name[32];
+        snprintf(name, sizeof(name), "%c %u", stats.hashmap, stats.command);
+        /// From the start of the driver
+        status.addf(name, "p50 %lu us, p99 %lu us, p99.9 %lu us, max %lu us, %lu answers, %lu retries, %lu timeouts",
+                    stats.latency.percentile(50), stats.latency.percentile(99), stats.latency.percentile(99.9),
+                    stats.latency.max(), stats.latency.count(), stats.retries.load(), stats.timeouts.load());
+        timeouts += stats.timeouts;
+    }
+    if (timeouts > serial_timeouts_)
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Serial transactions without answer");
+    else
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Serial transactions answered");
+    serial_timeouts_ = timeouts;
 }
 
-void ORBHardware::addVectorPacketRequest(const boost::function<void (std::vector<packet_information_t>*) >& callback) {
+void ORBHardware::addVectorPacketRequest(const boost::function<void (PacketList*) >& callback) {
     callback_add_packet = callback;
 }
 
@@ -147,7 +385,7 @@ void ORBHardware::clearVectorPacketRequest() {
     callback_add_packet.clear();
 }
 
-void ORBHardware::addParameterPacketRequest(const boost::function<void (std::vector<packet_information_t>*) >& callback) {
+void ORBHardware::addParameterPacketRequest(const boost::function<void (StartupPlanner*) >& callback) {
     callback_add_parameter = callback;
 }
 
@@ -171,14 +409,13 @@ std::string ORBHardware::getTypeBoard() {
     return type_board_;
 }
 
-std::vector<packet_information_t> ORBHardware::updatePacket() {
-    std::vector<packet_information_t> list_packet;
+void ORBHardware::updatePacket(PacketList* list_packet) {
+    list_packet->clear();
     if (callback_add_packet)
-        callback_add_packet(&list_packet);
+        callback_add_packet(list_packet);
 //    if (pub_time_process.getNumSubscribers() >= 1) {
-//        list_packet.push_back(serial_->createPacket(TIME_PROCESS, REQUEST));
+//        list_packet->push_back(serial_->createPacket(TIME_PROCESS, REQUEST));
 //    }
-    return list_packet;
 }
 
 void ORBHardware::connectCallback(const ros::SingleSubscriberPublisher& pub) {
@@ -196,11 +433,17 @@ float ORBHardware::getTimeProcess(float process_time) {
     return k_time*process_time;
 }
 
-void ORBHardware::errorPacket(const unsigned char& command, const message_abstract_u* packet) {
+void ORBHardware::errorPacket(const unsigned char& command, const message_abstract_u*) {
     ROS_ERROR("Error on command: %d", command);
+    nacks_++;
 }
 
 void ORBHardware::defaultPacket(const unsigned char& command, const message_abstract_u* packet) {
+    /// Registers the receive thread of PacketSerial, the executor has already its ring
+    Tracer::thread("serial_rx");
+    TraceScope trace("defaultPacket", "serial");
+    if (window_ != NULL)
+        window_->receive(HASHMAP_SYSTEM, command, packet);
     switch (command) {
         case SYSTEM_SERVICE:
             decodeServices(packet->system.service.command, &packet->system.service.buffer[0]);
@@ -313,8 +556,8 @@ packet_information_t ORBHardware::encodeServices(char command, unsigned char* bu
 }
 
 void ORBHardware::resetBoard(unsigned int repeat) {
-    for (int i = 0; i < repeat; i++)
-        serial_->sendAsyncPacket(serial_->encoder(encodeServices(SERVICE_RESET)));
+    for (unsigned int i = 0; i < repeat; i++)
+        executor_.post(TransactionPolicy::CONFIGURATION, serial_->encoder(encodeServices(SERVICE_RESET)));
 }
 
 void ORBHardware::decodeServices(const char command, const unsigned char* buffer) {
@@ -344,7 +587,7 @@ void ORBHardware::decodeServices(const char command, const unsigned char* buffer
 
 std::string ORBHardware::getBoardSerialError() {
     try {
-        serial_->parserSendPacket(serial_->createPacket(SYSTEM_SERIAL_ERROR, PACKET_REQUEST), 3, boost::posix_time::millisec(200));
+        executor_.execute(TransactionPolicy::CONFIGURATION, serial_->encoder(serial_->createPacket(SYSTEM_SERIAL_ERROR, PACKET_REQUEST)));
     } catch (std::exception& e) {
         ROS_ERROR("%s", e.what());
     }
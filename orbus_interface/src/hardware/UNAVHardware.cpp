@@ -6,11 +6,16 @@
  */
 
 #include "hardware/UNAVHardware.h"
+#include "realtime/Tracer.h"
+
 #include <limits>
 
+#include <ros/callback_queue.h>
+
 #include <boost/assign/list_of.hpp>
 // Boost header needed:
 #include <boost/lexical_cast.hpp>
+#include <boost/chrono.hpp>
 
 #include "urdf_parser/urdf_parser.h"
 
@@ -24,8 +29,22 @@ namespace
   const uint8_t LEFT = 0, RIGHT = 1;
 }
 
+motor_control_t UNAVHardware::velocityToBoard(double velocity) {
+    long int velocity_long = (long int) (velocity * 1000);
+    if (velocity_long > 32767) {
+        return 32767;
+    } else if (velocity_long < -32768) {
+        return -32768;
+    }
+    return (motor_control_t) velocity_long;
+}
+
 UNAVHardware::UNAVHardware(const ros::NodeHandle& nh, const ros::NodeHandle &private_nh, ParserPacket* serial)
-: ORBHardware(nh, private_nh, serial) {
+: ORBHardware(nh, private_nh, serial), measure_mask_(0), measure_requested_(false),
+  status_group_(0), status_interval_(0), status_pending_(false), status_cycles_(0) {
+
+    /// The callbacks of the executor reach this object only now that its type is UNAVHardware
+    start();
 
     /// Verify correct type board
     if (type_board_.compare("Motor Control") != 0) {
@@ -36,14 +55,59 @@ UNAVHardware::UNAVHardware(const ros::NodeHandle& nh, const ros::NodeHandle &pri
     serial->addCallback(&UNAVHardware::motorPacket, this, HASHMAP_MOTOR);
     addParameterPacketRequest(&UNAVHardware::addParameter, this);
 
-    /// Load all parameters
-    loadParameter();
+    /// Load URDF from robot_description
+    if(nh_.hasParam("/robot_description")) {
+        std::string urdf_string;
+        nh_.getParam("/robot_description", urdf_string);
+        urdf_ = urdf::parseURDF(urdf_string);
+    }
 
     /// Register all control interface avaiable
     registerControlInterfaces();
+
+    /// Load all parameters, with the joint limits, in a single exchange
+    loadParameter();
+
+    /// The answers are on the parameter server, start the dynamic reconfigure
+    for(unsigned int i=0; i < NUM_MOTORS; ++i) {
+        joints_[i].configurator_pid->initialize();
+        joints_[i].configurator_param->initialize();
+        joints_[i].configurator_emergency->initialize();
+    }
+
+    /// Stream of measures from the board
+    private_nh_.param<double>("measure_stream_rate", stream_rate_, 0.0);
+    /// Read and write in a single transaction every control tick
+    private_nh_.param<bool>("combined_transaction", combined_, false);
+    combined_ = combined_ && stream_rate_ <= 0;
+    /// With the stream, the measures are stale after three stream periods
+    if (stream_rate_ > 0 && !private_nh_.hasParam("measure_max_delay"))
+        measure_max_delay_ = 3.0 / stream_rate_;
+    /// Never wait the board to write the velocity references
+    private_nh_.param<bool>("async_commands", async_commands_, false);
+    if (async_commands_)
+        diagnostic_.add("Velocity references", this, &UNAVHardware::commandDiagnostics);
+
+    /// Frames sent every control tick
+    buildFrames();
+
+    /// Status of the board, a group every poll, all groups every diagnostic tick
+    bool status_polling;
+    double diagnostic_frequency;
+    private_nh_.param<bool>("status_polling", status_polling, true);
+    private_nh_.param<double>("diagnostic_frequency", diagnostic_frequency, 10.0);
+    if (status_polling && diagnostic_frequency > 0)
+        status_interval_ = 1.0 / (diagnostic_frequency * STATUS_GROUPS);
+    buildStatusFrames();
+    status_callback_ = boost::bind(&UNAVHardware::statusPolled, this, _1, _2);
+    status_time_ = boost::chrono::steady_clock::now();
+    pub_status_ = nh_.advertise<orbus_msgs::UnavStatus>("status", 10);
 }
 
 UNAVHardware::~UNAVHardware() {
+    stream_timer_.stop();
+    /// No more answers dispatched to motorPacket
+    executor_.stop();
     serial_->clearCallback(HASHMAP_MOTION);
     serial_->clearCallback(HASHMAP_MOTOR);
     clearParameterPacketRequest();
@@ -111,21 +175,15 @@ void UNAVHardware::setupLimits(hardware_interface::JointHandle joint_handle, ros
         ROS_INFO_STREAM("LOAD " << joint_names[i] << " limits from ROSPARAM: " << limits.max_velocity);
     }
 
-    // Send joint limits information to board
+    // Joint limits information for the board, sent by loadParameter
     motor_t constraint;
     constraint.position = -1;
     constraint.velocity = (motor_control_t) limits.max_velocity*1000;
     constraint.torque = -1;
     motor_command_map_t command;
     command.bitset.motor = i;
-    command.bitset.motor = MOTOR_CONSTRAINT;
-
-    packet_t packet_send = serial_->encoder(serial_->createDataPacket(command.command_message, HASHMAP_MOTOR, (message_abstract_u*) & constraint));
-    try {
-        serial_->sendSyncPacket(packet_send, 3, boost::posix_time::millisec(200));
-    } catch (exception &e) {
-        ROS_ERROR("%s", e.what());
-    }
+    command.bitset.command = MOTOR_CONSTRAINT;
+    list_limits_.push_back(serial_->createDataPacket(command.command_message, HASHMAP_MOTOR, (message_abstract_u*) & constraint));
 
     joint_limits_interface::VelocityJointSoftLimitsHandle handle(joint_handle, // We read the state and read/write the command
                                                                  limits,       // Limits spec
@@ -134,89 +192,377 @@ void UNAVHardware::setupLimits(hardware_interface::JointHandle joint_handle, ros
     vel_limits_interface_.registerHandle(handle);
 }
 
-void UNAVHardware::updateJointsFromHardware() {
-    //ROS_INFO("Update Joints");
-    /// Send a list of request about position and velocities
-    list_send_.clear();     ///< Clear list of commands
-    motor_command_.bitset.command = MOTOR_MEASURE; ///< Set message to receive measure information
+void UNAVHardware::buildFrames() {
+    /// Measures of all motors
+    list_read_.clear();
+    addMeasureRequest(&list_read_);
+    read_frame_.build(serial_, list_read_);
+    /// Velocity references of all motors, the first NUM_MOTORS messages
+    list_write_.clear();
+    motor_command_map_t command;
+    command.bitset.command = MOTOR_VEL_REF;
     for(int i = 0; i < NUM_MOTORS; ++i) {
-        motor_command_.bitset.motor = i;
-        list_send_.push_back(serial_->createPacket(motor_command_.command_message, PACKET_REQUEST, HASHMAP_MOTOR));
+        command.bitset.motor = i;
+        motor_control_t velocity = 0;
+        list_write_.push_back(serial_->createDataPacket(command.command_message, HASHMAP_MOTOR, (message_abstract_u*) & velocity));
+    }
+    if (combined_) {
+        /// Measures for the next tick in the same frame of the references
+        addMeasureRequest(&list_write_);
+    }
+    write_frame_.build(serial_, list_write_);
+
+    /// Bytes of every tick: the references with their ACK, and the measures
+    double overhead = ORBUS_FRAME_HEAD + ORBUS_FRAME_TAIL;
+    double measures = NUM_MOTORS * (ORBUS_MESSAGE_HEAD + sizeof(motor_t));
+    double sent = overhead + write_frame_.packet().length;
+    double received = overhead + NUM_MOTORS * ORBUS_MESSAGE_HEAD;
+    if (combined_) {
+        received += measures;
+    } else {
+        /// With the stream, the part of the measures of a tick
+        double ratio = (stream_rate_ > 0) ? stream_rate_ / loop_.frequency() : 1.0;
+        sent += ratio * (overhead + read_frame_.packet().length);
+        received += ratio * (overhead + measures);
+    }
+    setTickTraffic(sent, received);
+}
+
+void UNAVHardware::buildStatusFrames() {
+    PacketList list_status;
+    motor_command_map_t command;
+    size_t payload[STATUS_GROUPS];
+    /// Diagnostic of a motor in every group
+    command.bitset.command = MOTOR_DIAGNOSTIC;
+    for(int i = 0; i < NUM_MOTORS; ++i) {
+        command.bitset.motor = i;
+        list_status.clear();
+        list_status.push_back(serial_->createPacket(command.command_message, PACKET_REQUEST, HASHMAP_MOTOR));
+        status_frames_[i].build(serial_, list_status);
+        payload[i] = sizeof(motor_diagnostic_t);
+    }
+    /// State of all motors in the last group
+    command.bitset.command = MOTOR_STATE;
+    list_status.clear();
+    for(int i = 0; i < NUM_MOTORS; ++i) {
+        command.bitset.motor = i;
+        list_status.push_back(serial_->createPacket(command.command_message, PACKET_REQUEST, HASHMAP_MOTOR));
+    }
+    status_frames_[NUM_MOTORS].build(serial_, list_status);
+    payload[NUM_MOTORS] = NUM_MOTORS * sizeof(motor_state_t);
+
+    for(unsigned int i = 0; i < STATUS_GROUPS; ++i) {
+        size_t messages = (i < NUM_MOTORS) ? 1 : NUM_MOTORS;
+        size_t bytes = 2 * (ORBUS_FRAME_HEAD + ORBUS_FRAME_TAIL) + status_frames_[i].packet().length
+                + messages * ORBUS_MESSAGE_HEAD + payload[i];
+        /// 8N1, ten bits on the line for every byte
+        status_airtime_us_[i] = (long) (bytes * 10 * 1e6 / serial_rate_);
+    }
+}
+
+void UNAVHardware::pollStatus() {
+    if (status_interval_ <= 0 || status_pending_)
+        return;
+    boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+    if (now < status_next_)
+        return;
+    /// Only if request and answer fit in the time left by the control transactions
+    TransactionPolicy::attempt_t attempt;
+    if (!policy_.schedule(TransactionPolicy::BACKGROUND, &attempt)
+            || attempt.timeout.total_microseconds() < status_airtime_us_[status_group_])
+        return;
+    status_pending_ = true;
+    if (!executor_.submit(TransactionPolicy::BACKGROUND, status_frames_[status_group_].packet(), status_callback_)) {
+        status_pending_ = false;
+        return;
+    }
+    status_group_ = (status_group_ + 1) % STATUS_GROUPS;
+    status_next_ = now + boost::chrono::duration_cast<boost::chrono::steady_clock::duration>(
+                boost::chrono::duration<double>(status_interval_));
+}
+
+void UNAVHardware::statusPolled(bool, const PacketList&) {
+    /// The answers are already decoded in motorPacket
+    status_pending_ = false;
+}
+
+void UNAVHardware::updateDiagnostics() {
+    ORBHardware::updateDiagnostics();
+    publishStatus();
+}
+
+void UNAVHardware::commandDiagnostics(diagnostic_updater::DiagnosticStatusWrapper& status) {
+    bool failed = false;
+    ros::V_string joint_names = boost::assign::list_of("Left")("Right");
+    for(int i = 0; i < NUM_MOTORS; ++i) {
+        unsigned int nack = joints_[i].command_nack, lost = joints_[i].command_lost;
+        status.addf(joint_names[i], "%u sent, %u ACK, %u NACK, %u lost",
+                    (unsigned int) joints_[i].command_sent, (unsigned int) joints_[i].command_ack, nack, lost);
+        failed = failed || nack > joints_[i].reported_nack || lost > joints_[i].reported_lost;
+        joints_[i].reported_nack = nack;
+        joints_[i].reported_lost = lost;
+    }
+    if (failed)
+        status.summary(diagnostic_msgs::DiagnosticStatus::WARN, "Velocity references refused or without answer");
+    else
+        status.summary(diagnostic_msgs::DiagnosticStatus::OK, "Velocity references acknowledged");
+}
+
+void UNAVHardware::publishStatus() {
+    /// Last status of the board, the message is filled in place
+    const board_status_t& status = status_buffer_.read();
+    boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+    double window = boost::chrono::duration<double>(now - status_time_).count();
+    unsigned long cycles = loop_.total();
+    if (window > 0)
+        status_msg_.ros_control_loop_freq = (cycles - status_cycles_) / window;
+    status_cycles_ = cycles;
+    status_time_ = now;
+
+    status_msg_.header.stamp = ros::Time::now();
+    status_msg_.left_driver_current = status.current[0];
+    status_msg_.right_driver_current = status.current[1];
+    status_msg_.left_driver_voltage = status.voltage[0];
+    status_msg_.right_driver_voltage = status.voltage[1];
+    status_msg_.left_motor_temp = status.temperature[0];
+    status_msg_.right_motor_temp = status.temperature[1];
+    status_msg_.timeout = false;
+    status_msg_.lockout = false;
+    long long stamp = boost::chrono::duration_cast<boost::chrono::nanoseconds>(now.time_since_epoch()).count();
+    for(int i = 0; i < NUM_MOTORS; ++i) {
+        /// The board stops a motor without references for the timeout of its emergency configuration
+        unsigned int timeout = joints_[i].configurator_emergency->timeout();
+        status_msg_.timeout = status_msg_.timeout || (timeout > 0 && stamp - joints_[i].command_time > timeout * 1000000LL);
+        /// Bridge disabled
+        status_msg_.lockout = status_msg_.lockout || (status.state[i] == STATE_CONTROL_DISABLE);
+    }
+    /// uptime and current_limit are not reported by the board, always 0
+    pub_status_.publish(status_msg_);
+}
+
+void UNAVHardware::startStream(ros::CallbackQueue* queue) {
+    if (stream_rate_ <= 0)
+        return;
+    ROS_INFO("Stream measures at %.1f Hz", stream_rate_);
+    ros::WallTimerOptions options(ros::WallDuration(1.0 / stream_rate_),
+                                  boost::bind(&UNAVHardware::streamMeasure, this, _1), queue);
+    stream_timer_ = nh_.createWallTimer(options);
+}
+
+void UNAVHardware::streamMeasure(const ros::WallTimerEvent&) {
+    /// The answers are decoded in motorPacket on the receive thread
+    if (!executor_.post(TransactionPolicy::CONTROL, read_frame_.packet()))
+        ROS_WARN_THROTTLE(1, "No transaction free to request the measures");
+}
+
+void UNAVHardware::addMeasureRequest(PacketList* list_send) {
+    motor_command_map_t command;
+    command.bitset.command = MOTOR_MEASURE; ///< Set message to receive measure information
+    for(int i = 0; i < NUM_MOTORS; ++i) {
+        command.bitset.motor = i;
+        list_send->push_back(serial_->createPacket(command.command_message, PACKET_REQUEST, HASHMAP_MOTOR));
+    }
+}
+
+void UNAVHardware::requestMeasures() {
+    /// Send the request about position and velocities
+    if (window_ != NULL) {
+        TransactionPolicy::attempt_t attempt;
+        if (!policy_.schedule(TransactionPolicy::CONTROL, &attempt)) {
+            ROS_WARN_THROTTLE(1, "No time left to read the measures");
+            return;
+        }
+        /// Measures arrive on motorPacket, an old measure is useless and it is never sent again
+        for (PacketList::iterator it = list_read_.begin(); it != list_read_.end(); ++it) {
+            window_->submit(*it, PacketWindow::callback_complete_t(), 0, attempt.timeout);
+        }
+        window_->update();
+        return;
     }
     try {
-        serial_->parserSendPacket(list_send_, 3, boost::posix_time::millisec(200));
+        /// parsing dispatches the measures to motorPacket
+        executor_.execute(TransactionPolicy::CONTROL, read_frame_.packet());
+    } catch (transaction_dropped &e) {
+        ROS_WARN_THROTTLE(1, "No time left to read the measures");
     } catch (exception &e) {
         ROS_ERROR("%s", e.what());
     }
 }
 
+void UNAVHardware::updateJointsFromHardware() {
+    //ROS_INFO("Update Joints");
+    /// With the stream, or after a combined write, the measures are already requested
+    if (stream_rate_ <= 0 && !measure_requested_)
+        requestMeasures();
+    measure_requested_ = false;
+
+    /// Last complete measure of all motors
+    const joint_measure_t& measure = measure_buffer_.read();
+    for(int i = 0; i < NUM_MOTORS; ++i) {
+        joints_[i].position = measure.position[i];
+        joints_[i].velocity = measure.velocity[i];
+        joints_[i].effort = measure.effort[i];
+    }
+    long long now = boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                boost::chrono::steady_clock::now().time_since_epoch()).count();
+    /// Age of the measures of this tick, none before the first
+    if (measure.stamp > 0)
+        loop_.stamp(now - measure.stamp);
+    if (stream_rate_ > 0) {
+        double age = (now - measure.stamp) * 1e-9;
+        if (age > 3.0 / stream_rate_) {
+            ROS_WARN_THROTTLE(1, "No measures from the board for %.3f s", age);
+        }
+    }
+}
+
 void UNAVHardware::writeCommandsToHardware(ros::Duration period) {
+    sendReferences(period);
+    /// The status uses only the time left by the control transactions
+    pollStatus();
+}
+
+void UNAVHardware::sendReferences(ros::Duration period) {
     //ROS_INFO("Write to Hardware");
 
     // Enforce joint limits for all registered handles
     // Note: one can also enforce limits on a per-handle basis: handle.enforceLimits(period)
     vel_limits_interface_.enforceLimits(period);
 
-    list_send_.clear();     ///< Clear list of commands
-    motor_command_.bitset.command = MOTOR_VEL_REF; ///< Set command to velocity control
+    /// Only the velocity references change from the last tick
     for(int i = 0; i < NUM_MOTORS; ++i) {
-        //Build a command message
-        motor_command_.bitset.motor = i;
-        /// Convert radiant velocity in milliradiant
-        long int velocity_long = (long int) joints_[i].velocity_command*1000;
-        motor_control_t velocity;
-        // >>>>> Saturation on 16 bit values
-        if(velocity_long > 32767) {
-            velocity = 32767;
-        } else if (velocity_long < -32768) {
-            velocity_long = -32768;
-        } else {
-            velocity = (motor_control_t) velocity_long;
-        }
-        // <<<<< Saturation on 16 bit values
-        list_send_.push_back(serial_->createDataPacket(motor_command_.command_message, HASHMAP_MOTOR, (message_abstract_u*) & velocity));
+        motor_control_t velocity = velocityToBoard(joints_[i].velocity_command);
+        write_frame_.patch(i, velocity);
+        memcpy(&list_write_[i].message, &velocity, sizeof(velocity));
     }
+    measure_requested_ = combined_;
     /// Send message
+    if (async_commands_) {
+        for(int i = 0; i < NUM_MOTORS; ++i) {
+            /// A reference still without answer is replaced by the new one, never sent again
+            if (joints_[i].command_pending.exchange(true))
+                joints_[i].command_lost++;
+            joints_[i].command_sent++;
+        }
+        /// Without a transaction the references are never answered, and counted lost at the next tick
+        if (!executor_.post(TransactionPolicy::CONTROL, write_frame_.packet()))
+            ROS_WARN_THROTTLE(1, "No transaction free to write the velocity references");
+        return;
+    }
+    if (window_ != NULL) {
+        TransactionPolicy::attempt_t attempt;
+        if (!policy_.schedule(TransactionPolicy::CONTROL, &attempt)) {
+            /// The next tick sends a newer reference
+            measure_requested_ = false;
+            ROS_WARN_THROTTLE(1, "No time left to write the velocity references");
+            return;
+        }
+        /// The next reference replaces a lost one, no retransmission
+        for (PacketList::iterator it = list_write_.begin(); it != list_write_.end(); ++it) {
+            window_->submit(*it, PacketWindow::callback_complete_t(), 0, attempt.timeout);
+        }
+        window_->update();
+        return;
+    }
     try {
-        serial_->parserSendPacket(list_send_, 3, boost::posix_time::millisec(200));
+        executor_.execute(TransactionPolicy::CONTROL, write_frame_.packet());
+    } catch (transaction_dropped &e) {
+        /// The next tick sends a newer reference
+        measure_requested_ = false;
+        ROS_WARN_THROTTLE(1, "No time left to write the velocity references");
     } catch (exception &e) {
+        /// Without answer the next tick asks again the measures
+        measure_requested_ = false;
         ROS_ERROR("%s", e.what());
     }
 }
 
-void UNAVHardware::addParameter(std::vector<packet_information_t>* list_send) {
+void UNAVHardware::addParameter(StartupPlanner* planner) {
     motor_command_map_t command;
     std::string number_motor_string;
     for(unsigned int i=0; i < NUM_MOTORS; ++i) {
         command.bitset.motor = i;
         number_motor_string = "motor_" + boost::lexical_cast<std::string>(i);
         /// PID
-        joints_[i].configurator_pid = new MotorPIDConfigurator(private_nh_, number_motor_string, i, serial_);
+        joints_[i].configurator_pid = new MotorPIDConfigurator(private_nh_, number_motor_string, i, serial_, &shadow_);
         /// Parameter motor
-        joints_[i].configurator_param = new MotorParamConfigurator(private_nh_, number_motor_string, i, serial_);
+        joints_[i].configurator_param = new MotorParamConfigurator(private_nh_, number_motor_string, i, serial_, &shadow_);
         /// Emergency motor
-        joints_[i].configurator_emergency = new MotorEmergencyConfigurator(private_nh_, number_motor_string, i, serial_);
+        joints_[i].configurator_emergency = new MotorEmergencyConfigurator(private_nh_, number_motor_string, i, serial_, &shadow_);
+        /// The parameters own the whole motor namespace, they are planned first
+        joints_[i].configurator_param->plan(planner, &cache_);
+        joints_[i].configurator_pid->plan(planner, &cache_);
+        joints_[i].configurator_emergency->plan(planner, &cache_);
         /// Reset position motor
         command.bitset.command = MOTOR_POS_RESET;
         motor_control_t reset_coord = 0;
-        list_send->push_back(serial_->createDataPacket(command.command_message,HASHMAP_MOTOR, (message_abstract_u*) & reset_coord));
-    }
-
-    /// Load URDF from robot_description
-    if(nh_.hasParam("/robot_description")) {
-        std::string urdf_string;
-        nh_.getParam("/robot_description", urdf_string);
-        urdf_ = urdf::parseURDF(urdf_string);
+        planner->add(serial_->createDataPacket(command.command_message,HASHMAP_MOTOR, (message_abstract_u*) & reset_coord));
     }
+    /// Joint limits
+    for (PacketList::iterator it = list_limits_.begin(); it != list_limits_.end(); ++it)
+        planner->add(*it);
 }
 
 void UNAVHardware::motorPacket(const unsigned char& command, const message_abstract_u* packet) {
-    motor_command_.command_message = command;
-    switch (motor_command_.bitset.command) {
-    case MOTOR_MEASURE:
-        joints_[motor_command_.bitset.motor].effort = packet->motor.motor.torque;
-        joints_[motor_command_.bitset.motor].position += packet->motor.motor.position_delta;
-        joints_[motor_command_.bitset.motor].velocity = ((double) packet->motor.motor.velocity) / 1000;
+    /// Answers are decoded on the executor or, when asynchronous, on the receive thread of PacketSerial
+    Tracer::thread("serial_rx");
+    TraceScope trace("motorPacket", "serial");
+    motor_command_map_t motor_command;
+    motor_command.command_message = command;
+    if (motor_command.bitset.motor >= NUM_MOTORS)
+        return;
+    switch (motor_command.bitset.command) {
+    case MOTOR_MEASURE: {
+        boost::mutex::scoped_lock lock(rx_mutex_);
+        measure_rx_.effort[motor_command.bitset.motor] = packet->motor.motor.torque;
+        measure_rx_.position[motor_command.bitset.motor] += packet->motor.motor.position_delta;
+        measure_rx_.velocity[motor_command.bitset.motor] = ((double) packet->motor.motor.velocity) / 1000;
+        measure_mask_ |= (1 << motor_command.bitset.motor);
+        /// Publish only when all motors are updated, never a left and right of different times
+        if (measure_mask_ == (1 << NUM_MOTORS) - 1) {
+            measure_rx_.stamp = boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                        boost::chrono::steady_clock::now().time_since_epoch()).count();
+            measure_buffer_.write(measure_rx_);
+            measure_mask_ = 0;
+        }
         break;
     }
+    case MOTOR_DIAGNOSTIC: {
+        boost::mutex::scoped_lock lock(rx_mutex_);
+        /// Board units: mV, mA
+        status_rx_.current[motor_command.bitset.motor] = ((double) packet->motor.diagnostic.current) / 1000;
+        status_rx_.voltage[motor_command.bitset.motor] = ((double) packet->motor.diagnostic.volt) / 1000;
+        status_rx_.temperature[motor_command.bitset.motor] = packet->motor.diagnostic.temperature;
+        status_buffer_.write(status_rx_);
+        break;
+    }
+    case MOTOR_STATE: {
+        boost::mutex::scoped_lock lock(rx_mutex_);
+        status_rx_.state[motor_command.bitset.motor] = packet->motor.state;
+        status_buffer_.write(status_rx_);
+        break;
+    }
+    case MOTOR_VEL_REF:
+        /// Answer to a velocity reference
+        joints_[motor_command.bitset.motor].command_time = boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+                    boost::chrono::steady_clock::now().time_since_epoch()).count();
+        if (joints_[motor_command.bitset.motor].command_pending.exchange(false))
+            joints_[motor_command.bitset.motor].command_ack++;
+        break;
+    }
+    if (window_ != NULL)
+        window_->receive(HASHMAP_MOTOR, command, packet);
+}
+
+void UNAVHardware::errorPacket(const unsigned char& command, const message_abstract_u* packet) {
+    ORBHardware::errorPacket(command, packet);
+    motor_command_map_t motor_command;
+    motor_command.command_message = command;
+    if (motor_command.bitset.motor >= NUM_MOTORS)
+        return;
+    /// Only the velocity references are tracked
+    if (motor_command.bitset.command == MOTOR_VEL_REF) {
+        if (joints_[motor_command.bitset.motor].command_pending.exchange(false))
+            joints_[motor_command.bitset.motor].command_nack++;
+    }
 }
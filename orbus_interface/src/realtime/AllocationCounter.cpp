@@ -0,0 +1,157 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#include "realtime/AllocationCounter.h"
+
+#ifdef ORBUS_COUNT_ALLOCATIONS
+
+#include <stdlib.h>
+#include <new>
+
+/// The replacements never throw, with the specification of the standard in use
+#if __cplusplus >= 201103L
+#define ALLOCATION_NOEXCEPT noexcept
+#else
+#define ALLOCATION_NOEXCEPT throw()
+#endif
+
+namespace
+{
+  /// Initial exec: the first access of a thread never allocates, also from a shared library
+  __thread unsigned long allocations __attribute__((tls_model("initial-exec"))) = 0;
+  __thread unsigned long allocated __attribute__((tls_model("initial-exec"))) = 0;
+
+  void count(size_t size) {
+      allocations++;
+      allocated += size;
+  }
+}
+
+#ifdef __GLIBC__
+
+/// The allocator of glibc, under the names that are not replaced here
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t number, size_t size);
+  void* __libc_realloc(void* memory, size_t size);
+}
+
+/// Every allocation of the process, operator new of libstdc++ included, goes through these
+extern "C" void* malloc(size_t size) {
+    count(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t number, size_t size) {
+    count(number * size);
+    return __libc_calloc(number, size);
+}
+
+/// A realloc can move the memory, it is counted as a new allocation
+extern "C" void* realloc(void* memory, size_t size) {
+    count(size);
+    return __libc_realloc(memory, size);
+}
+
+#else
+
+namespace
+{
+  void* allocate(size_t size) {
+      count(size);
+      return malloc(size > 0 ? size : 1);
+  }
+}
+
+/// Without glibc only operator new is counted
+
+void* operator new(size_t size) {
+    void* memory = allocate(size);
+    if (memory == NULL)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    void* memory = allocate(size);
+    if (memory == NULL)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) ALLOCATION_NOEXCEPT {
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) ALLOCATION_NOEXCEPT {
+    return allocate(size);
+}
+
+void operator delete(void* memory) ALLOCATION_NOEXCEPT {
+    free(memory);
+}
+
+void operator delete[](void* memory) ALLOCATION_NOEXCEPT {
+    free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) ALLOCATION_NOEXCEPT {
+    free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) ALLOCATION_NOEXCEPT {
+    free(memory);
+}
+
+#endif // __GLIBC__
+
+bool AllocationCounter::enabled() {
+    return true;
+}
+
+AllocationCounter::sample_t AllocationCounter::sample() {
+    sample_t sample;
+    sample.count = allocations;
+    sample.bytes = allocated;
+    return sample;
+}
+
+#else
+
+bool AllocationCounter::enabled() {
+    return false;
+}
+
+AllocationCounter::sample_t AllocationCounter::sample() {
+    return sample_t();
+}
+
+#endif
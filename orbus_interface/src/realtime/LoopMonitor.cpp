@@ -0,0 +1,115 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#include "realtime/LoopMonitor.h"
+#include "realtime/Tracer.h"
+
+#include <limits>
+
+LoopMonitor::LoopMonitor()
+: frequency_(0), period_ns_(0), total_(0), cycles_(0), overruns_(0), jitter_sum_(0), jitter_max_(0),
+  cycle_sum_(0), cycle_max_(0), durations_(0), last_(0), stamps_(0),
+  delay_min_(std::numeric_limits<long long>::max()), delay_max_(std::numeric_limits<long long>::min()),
+  window_start_(Tracer::now()) {
+}
+
+void LoopMonitor::setFrequency(double frequency) {
+    frequency_ = frequency;
+    period_ns_ = (frequency > 0) ? (long long) (1e9 / frequency) : 0;
+}
+
+void LoopMonitor::period(long long period) {
+    last_.store(Tracer::now(), boost::memory_order_relaxed);
+    total_.fetch_add(1, boost::memory_order_relaxed);
+    cycles_.fetch_add(1, boost::memory_order_relaxed);
+    if (period_ns_ == 0)
+        return;
+    /// A cycle started half a period late missed its deadline
+    if (period > period_ns_ + period_ns_ / 2)
+        overruns_.fetch_add(1, boost::memory_order_relaxed);
+    long long deviation = period - period_ns_;
+    unsigned long jitter = (unsigned long) ((deviation < 0 ? -deviation : deviation) / 1000);
+    jitter_sum_.fetch_add(jitter, boost::memory_order_relaxed);
+    updateMax(jitter_max_, jitter);
+}
+
+void LoopMonitor::cycle(long long duration) {
+    unsigned long microseconds = (unsigned long) (duration / 1000);
+    durations_.fetch_add(1, boost::memory_order_relaxed);
+    cycle_sum_.fetch_add(microseconds, boost::memory_order_relaxed);
+    updateMax(cycle_max_, microseconds);
+}
+
+void LoopMonitor::stamp(long long delay) {
+    stamps_.fetch_add(1, boost::memory_order_relaxed);
+    updateMin(delay_min_, delay);
+    updateMax(delay_max_, delay);
+}
+
+LoopMonitor::stats_t LoopMonitor::collect() {
+    long long now = Tracer::now();
+    stats_t stats;
+    stats.window = (now - window_start_) * 1e-9;
+    window_start_ = now;
+    stats.cycles = cycles_.exchange(0);
+    stats.overruns = overruns_.exchange(0);
+    unsigned long jitter_sum = jitter_sum_.exchange(0);
+    stats.jitter_mean = (stats.cycles > 0) ? (double) jitter_sum / stats.cycles : 0.0;
+    stats.jitter_max = jitter_max_.exchange(0);
+    unsigned long durations = durations_.exchange(0);
+    unsigned long cycle_sum = cycle_sum_.exchange(0);
+    stats.cycle_mean = (durations > 0) ? (double) cycle_sum / durations : 0.0;
+    stats.cycle_max = cycle_max_.exchange(0);
+    long long last = last_.load(boost::memory_order_relaxed);
+    stats.since_last = (last > 0) ? (now - last) * 1e-9 : -1.0;
+    stats.stamps = stamps_.exchange(0);
+    stats.delay_min = delay_min_.exchange(std::numeric_limits<long long>::max()) * 1e-9;
+    stats.delay_max = delay_max_.exchange(std::numeric_limits<long long>::min()) * 1e-9;
+    return stats;
+}
+
+void LoopMonitor::updateMax(boost::atomic<unsigned long>& max, unsigned long value) {
+    unsigned long current = max.load(boost::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, boost::memory_order_relaxed)) {
+    }
+}
+
+void LoopMonitor::updateMin(boost::atomic<long long>& min, long long value) {
+    long long current = min.load(boost::memory_order_relaxed);
+    while (value < current && !min.compare_exchange_weak(current, value, boost::memory_order_relaxed)) {
+    }
+}
+
+void LoopMonitor::updateMax(boost::atomic<long long>& max, long long value) {
+    long long current = max.load(boost::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, boost::memory_order_relaxed)) {
+    }
+}
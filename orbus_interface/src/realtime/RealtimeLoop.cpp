@@ -0,0 +1,147 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#include "realtime/RealtimeLoop.h"
+#include "realtime/Tracer.h"
+
+#include <ros/ros.h>
+
+#include <alloca.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define NSEC_PER_SEC 1000000000L
+
+namespace
+{
+  /// Add nanoseconds to a timespec
+  void timespecAdd(struct timespec& time, long ns) {
+      time.tv_nsec += ns;
+      while (time.tv_nsec >= NSEC_PER_SEC) {
+          time.tv_nsec -= NSEC_PER_SEC;
+          time.tv_sec++;
+      }
+  }
+
+  bool timespecAfter(const struct timespec& a, const struct timespec& b) {
+      return (a.tv_sec > b.tv_sec) || (a.tv_sec == b.tv_sec && a.tv_nsec > b.tv_nsec);
+  }
+
+  /// Touch the stack, the pages are mapped before the first cycle
+  void prefaultStack(size_t size) {
+      if (size == 0)
+          return;
+      volatile unsigned char* stack = (volatile unsigned char*) alloca(size);
+      for (size_t i = 0; i < size; i += 1024)
+          stack[i] = 0;
+  }
+}
+
+RealtimeLoop::RealtimeLoop(double frequency, const boost::function<void ()>& callback, const options_t& options)
+: period_ns_((long) (NSEC_PER_SEC / frequency)), callback_(callback), options_(options), running_(false), overruns_(0) {
+}
+
+RealtimeLoop::~RealtimeLoop() {
+    stop();
+}
+
+RealtimeLoop::overrun_t RealtimeLoop::overrunFromString(const std::string& name) {
+    if (name.compare("catchup") == 0)
+        return OVERRUN_CATCHUP;
+    return OVERRUN_SKIP;
+}
+
+void RealtimeLoop::start() {
+    if (running_)
+        return;
+    if (options_.lock_memory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+            ROS_WARN("Realtime loop: mlockall failed: %s", strerror(errno));
+    }
+    running_ = true;
+    thread_ = boost::thread(&RealtimeLoop::run, this);
+}
+
+void RealtimeLoop::stop() {
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void RealtimeLoop::setupThread() {
+    if (options_.cpu >= 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(options_.cpu, &cpuset);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+        if (err != 0)
+            ROS_WARN("Realtime loop: cannot pin on CPU %d: %s", options_.cpu, strerror(err));
+    }
+    if (options_.priority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = options_.priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0)
+            ROS_WARN("Realtime loop: cannot set SCHED_FIFO priority %d: %s", options_.priority, strerror(err));
+    }
+    prefaultStack(options_.stack_prefault);
+}
+
+void RealtimeLoop::run() {
+    setupThread();
+    Tracer::thread("control");
+
+    struct timespec next, now;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (running_) {
+        callback_();
+
+        timespecAdd(next, period_ns_);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (timespecAfter(now, next)) {
+            overruns_++;
+            if (options_.overrun == OVERRUN_SKIP) {
+                /// Wait the first deadline still in the future
+                while (!timespecAfter(next, now))
+                    timespecAdd(next, period_ns_);
+            }
+        }
+        /// A signal does not anticipate the next cycle
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
+        }
+        /// Time from the deadline to the wake up, lost in the scheduler
+        Tracer::record("wakeup", "scheduling", (long long) next.tv_sec * 1000000000LL + next.tv_nsec, Tracer::now());
+    }
+}
@@ -0,0 +1,158 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#include "realtime/Tracer.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+
+/// Threads with a ring, the spans of other threads are not recorded
+#define TRACER_THREADS 16
+
+namespace
+{
+  struct event_t {
+      const char* name;
+      const char* category;
+      long long begin;
+      long long end;
+  };
+
+  /// Written only by its thread, read by dump
+  struct ring_t {
+      char name[32];
+      std::vector<event_t> events;
+      /// Spans written from the start
+      boost::atomic<unsigned long long> head;
+
+      ring_t(const char* thread, size_t size) : events(size), head(0) {
+          strncpy(name, thread, sizeof(name) - 1);
+          name[sizeof(name) - 1] = '\0';
+      }
+  };
+
+  boost::atomic<bool> recording(false);
+  boost::atomic<size_t> ring_size(8192);
+  boost::atomic<ring_t*> rings[TRACER_THREADS];
+  boost::atomic<unsigned int> threads(0);
+  boost::mutex dumping;
+
+  __thread ring_t* current = NULL;
+  /// No ring left for the thread
+  __thread bool refused = false;
+}
+
+void Tracer::enable(bool enable, size_t events) {
+    ring_size = (events > 0) ? events : 1;
+    recording = enable;
+}
+
+bool Tracer::enabled() {
+    return recording.load(boost::memory_order_relaxed);
+}
+
+void Tracer::thread(const char* name) {
+    if (current != NULL || refused || !enabled())
+        return;
+    unsigned int index = threads.fetch_add(1);
+    if (index >= TRACER_THREADS) {
+        refused = true;
+        return;
+    }
+    current = new ring_t(name, ring_size);
+    rings[index].store(current, boost::memory_order_release);
+}
+
+long long Tracer::now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void Tracer::record(const char* name, const char* category, long long begin, long long end) {
+    if (!enabled())
+        return;
+    /// Never an allocation here: a thread never registered is not traced
+    if (current == NULL)
+        return;
+    unsigned long long head = current->head.load(boost::memory_order_relaxed);
+    event_t& event = current->events[head % current->events.size()];
+    event.name = name;
+    event.category = category;
+    event.begin = begin;
+    event.end = end;
+    current->head.store(head + 1, boost::memory_order_release);
+}
+
+bool Tracer::dump(const std::string& path) {
+    boost::mutex::scoped_lock lock(dumping);
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == NULL)
+        return false;
+    int pid = getpid();
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    unsigned int count = std::min(threads.load(), (unsigned int) TRACER_THREADS);
+    for (unsigned int tid = 0; tid < count; ++tid) {
+        ring_t* ring = rings[tid].load(boost::memory_order_acquire);
+        if (ring == NULL)
+            continue;
+        if (ring->name[0] != '\0') {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", pid, tid, ring->name);
+            first = false;
+        }
+        /// Copy while the thread writes, then keep only the spans not overwritten meanwhile
+        size_t size = ring->events.size();
+        unsigned long long head = ring->head.load(boost::memory_order_acquire);
+        unsigned long long begin = (head > size) ? head - size : 0;
+        std::vector<event_t> events(ring->events.begin(), ring->events.end());
+        unsigned long long last = ring->head.load(boost::memory_order_acquire);
+        if (last >= size && last - size + 1 > begin)
+            begin = last - size + 1;
+        for (unsigned long long i = begin; i < head; ++i) {
+            const event_t& event = events[i % size];
+            fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", event.name, event.category, pid, tid,
+                    event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
@@ -0,0 +1,63 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#include "transport/FrameTemplate.h"
+#include "transport/ORBusFrame.h"
+
+#include <string.h>
+
+using namespace std;
+
+FrameTemplate::FrameTemplate() {
+    packet_.length = 0;
+}
+
+void FrameTemplate::build(ParserPacket* serial, const std::vector<packet_information_t>& list_send) {
+    packet_ = serial->encoder(list_send);
+
+    /// Every message starts with its length: the payload follows the message head
+    offset_.assign(list_send.size(), -1);
+    size_t offset = 0;
+    for (unsigned int i = 0; i < list_send.size(); ++i) {
+        if (offset + ORBUS_MESSAGE_HEAD > packet_.length || packet_.buffer[offset] < ORBUS_MESSAGE_HEAD)
+            break;
+        if (packet_.buffer[offset] > ORBUS_MESSAGE_HEAD)
+            offset_[i] = offset + ORBUS_MESSAGE_HEAD;
+        offset += packet_.buffer[offset];
+    }
+}
+
+bool FrameTemplate::patch(unsigned int index, const void* data, size_t length) {
+    if (index >= offset_.size() || offset_[index] < 0 || offset_[index] + length > packet_.length)
+        return false;
+    memcpy(&packet_.buffer[offset_[index]], data, length);
+    return true;
+}
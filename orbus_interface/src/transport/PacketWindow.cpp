@@ -0,0 +1,132 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#include "transport/PacketWindow.h"
+
+using namespace std;
+
+PacketWindow::PacketWindow(ParserPacket* serial, SerialExecutor* executor, unsigned int size)
+: serial_(serial), executor_(executor), size_(size) {
+}
+
+bool PacketWindow::submit(const packet_information_t& packet, const callback_complete_t& callback,
+                          unsigned int repeat, boost::posix_time::millisec timeout) {
+    request_t request;
+    request.packet = packet;
+    request.callback = callback;
+    request.repeat = repeat;
+    request.timeout = boost::chrono::milliseconds(timeout.total_milliseconds());
+
+    boost::mutex::scoped_lock lock(mutex_);
+    if (flight_.size() < size_) {
+        flight_.push_back(request);
+        transmit(flight_.back());
+        return true;
+    }
+    /// Keep at most one window of requests waiting for a free slot
+    if (queue_.size() >= size_)
+        return false;
+    queue_.push_back(request);
+    return true;
+}
+
+void PacketWindow::receive(unsigned char type, unsigned char command, const message_abstract_u* packet) {
+    callback_complete_t callback;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        deque<request_t>::iterator it;
+        for (it = flight_.begin(); it != flight_.end(); ++it) {
+            if (it->packet.type == type && it->packet.command == command)
+                break;
+        }
+        if (it == flight_.end())
+            return;
+        callback = it->callback;
+        flight_.erase(it);
+        fill();
+    }
+    if (callback)
+        callback(true, packet);
+}
+
+void PacketWindow::update() {
+    while (true) {
+        callback_complete_t callback;
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            clock_t::time_point now = clock_t::now();
+            deque<request_t>::iterator it;
+            for (it = flight_.begin(); it != flight_.end(); ++it) {
+                if (it->deadline <= now)
+                    break;
+            }
+            if (it == flight_.end()) {
+                fill();
+                return;
+            }
+            if (it->repeat > 0) {
+                /// Retransmit, the request keeps its place in the window
+                it->repeat--;
+                transmit(*it);
+                continue;
+            }
+            callback = it->callback;
+            flight_.erase(it);
+            fill();
+        }
+        if (callback)
+            callback(false, NULL);
+    }
+}
+
+void PacketWindow::clear() {
+    boost::mutex::scoped_lock lock(mutex_);
+    flight_.clear();
+    queue_.clear();
+}
+
+unsigned int PacketWindow::inFlight() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return flight_.size();
+}
+
+void PacketWindow::transmit(request_t& request) {
+    request.deadline = clock_t::now() + request.timeout;
+    executor_->post(TransactionPolicy::CONTROL, serial_->encoder(request.packet));
+}
+
+void PacketWindow::fill() {
+    while (flight_.size() < size_ && !queue_.empty()) {
+        flight_.push_back(queue_.front());
+        queue_.pop_front();
+        transmit(flight_.back());
+    }
+}
@@ -0,0 +1,382 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#include "transport/SerialExecutor.h"
+#include "transport/ORBusFrame.h"
+#include "realtime/Tracer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+/// Transactions allocated at startup, the pool never grows
+#define EXECUTOR_POOL 32
+
+using namespace std;
+
+namespace
+{
+  /// State of a transaction waited by execute()
+  struct wait_t {
+      boost::interprocess::interprocess_semaphore done;
+      bool success;
+      PacketList* receive;
+
+      wait_t(PacketList* receive) : done(0), success(false), receive(receive) {
+      }
+
+      void complete(bool success, const PacketList& receive) {
+          this->success = success;
+          if (this->receive != NULL)
+              this->receive->assign(receive);
+          done.post();
+      }
+  };
+}
+
+SerialExecutor::SerialExecutor(ParserPacket* serial, TransactionPolicy* policy)
+: serial_(serial), policy_(policy), running_(false),
+  control_queue_(EXECUTOR_POOL), config_queue_(EXECUTOR_POOL), background_queue_(EXECUTOR_POOL), free_(EXECUTOR_POOL), pending_(0), commands_(0), sent_(0), received_(0),
+  sent_frames_(0), received_frames_(0), overflows_(0) {
+    for (unsigned int i = 0; i < EXECUTOR_POOL; ++i)
+        free_.bounded_push(new transaction_t());
+}
+
+SerialExecutor::~SerialExecutor() {
+    stop();
+    transaction_t* transaction;
+    while (control_queue_.pop(transaction))
+        delete transaction;
+    while (config_queue_.pop(transaction))
+        delete transaction;
+    while (background_queue_.pop(transaction))
+        delete transaction;
+    while (free_.pop(transaction))
+        delete transaction;
+}
+
+void SerialExecutor::start() {
+    if (running_)
+        return;
+    running_ = true;
+    thread_ = boost::thread(&SerialExecutor::run, this);
+}
+
+void SerialExecutor::stop() {
+    if (!running_)
+        return;
+    running_ = false;
+    /// Wake up the executor, it fails the transactions still queued
+    pending_.post();
+    thread_.join();
+}
+
+bool SerialExecutor::submit(TransactionPolicy::traffic_t traffic, const packet_t& packet, const callback_t& callback) {
+    return schedule(traffic, packet, callback) != NULL;
+}
+
+bool SerialExecutor::post(TransactionPolicy::traffic_t traffic, const packet_t& packet) {
+    /// Never served once stopped
+    if (!running_)
+        return false;
+    transaction_t* transaction = acquire();
+    if (transaction == NULL)
+        return false;
+    transaction->packet = packet;
+    transaction->traffic = traffic;
+    transaction->async = true;
+    /// Nothing waits for it, it is never late
+    transaction->deadline = TransactionPolicy::clock_t::time_point::max();
+    transaction->callback.clear();
+    renew(transaction);
+    enqueue(transaction);
+    return true;
+}
+
+void SerialExecutor::execute(TransactionPolicy::traffic_t traffic, const packet_t& packet, PacketList* receive) {
+    if (boost::this_thread::get_id() == thread_.get_id()) {
+        /// Called from a callback of the executor, the queue would never be served
+        throw std::runtime_error("SerialExecutor: execute called from the executor thread");
+    }
+    wait_t wait(receive);
+    unsigned int queued;
+    TransactionPolicy::clock_t::time_point deadline;
+    /// The transaction can be completed and used again before schedule returns, keep queued and deadline
+    transaction_t* transaction = schedule(traffic, packet, boost::bind(&wait_t::complete, &wait, _1, _2), &queued, &deadline);
+    if (transaction == NULL)
+        throw transaction_dropped("No time left or no transaction free for the serial transaction");
+    /// The semaphore waits on the system clock
+    boost::posix_time::ptime until = boost::posix_time::microsec_clock::universal_time()
+            + boost::posix_time::microseconds(boost::chrono::duration_cast<boost::chrono::microseconds>(
+                                                  deadline - TransactionPolicy::clock_t::now()).count());
+    if (!wait.done.timed_wait(until)) {
+        /// Fails if the executor completed it, even if the transaction is already used again
+        if (transaction->state.compare_exchange_strong(queued, (queued & ~STATE_MASK) | CANCELLED))
+            throw std::runtime_error("Serial transaction without answer before its deadline");
+        /// The executor is already calling back, wait holds its answer
+        wait.done.wait();
+    }
+    if (!wait.success)
+        throw std::runtime_error("Serial transaction without answer");
+}
+
+SerialExecutor::transaction_t* SerialExecutor::acquire() {
+    transaction_t* transaction;
+    if (free_.pop(transaction))
+        return transaction;
+    /// All transactions in use, the pool never grows from the control thread
+    overflows_.fetch_add(1, boost::memory_order_relaxed);
+    return NULL;
+}
+
+void SerialExecutor::release(transaction_t* transaction) {
+    transaction->callback.clear();
+    free_.bounded_push(transaction);
+}
+
+unsigned int SerialExecutor::renew(transaction_t* transaction) {
+    unsigned int state = ((transaction->state.load() & ~STATE_MASK) + STATE_MASK + 1) | QUEUED;
+    transaction->state.store(state);
+    return state;
+}
+
+SerialExecutor::transaction_t* SerialExecutor::schedule(TransactionPolicy::traffic_t traffic, const packet_t& packet, const callback_t& callback,
+                                                        unsigned int* queued, TransactionPolicy::clock_t::time_point* deadline) {
+    /// Never served once stopped
+    if (!running_)
+        return NULL;
+    TransactionPolicy::attempt_t attempt;
+    if (!policy_->schedule(traffic, &attempt))
+        return NULL;
+    transaction_t* transaction = acquire();
+    if (transaction == NULL)
+        return NULL;
+    transaction->packet = packet;
+    transaction->traffic = traffic;
+    transaction->async = false;
+    transaction->repeat = attempt.repeat;
+    transaction->attempt = 0;
+    transaction->timeout_ms = attempt.timeout.total_milliseconds();
+    transaction->deadline = attempt.deadline;
+    transaction->callback = callback;
+    unsigned int state = renew(transaction);
+    if (queued != NULL)
+        *queued = state;
+    if (deadline != NULL)
+        *deadline = attempt.deadline;
+    enqueue(transaction);
+    return transaction;
+}
+
+void SerialExecutor::enqueue(transaction_t* transaction) {
+    queue_t* queue = &control_queue_;
+    if (transaction->traffic == TransactionPolicy::CONFIGURATION)
+        queue = &config_queue_;
+    else if (transaction->traffic == TransactionPolicy::BACKGROUND)
+        queue = &background_queue_;
+    /// Every queue holds the whole pool
+    queue->bounded_push(transaction);
+    pending_.post();
+}
+
+void SerialExecutor::run() {
+    Tracer::thread("serial");
+    while (true) {
+        pending_.wait();
+        if (!running_)
+            break;
+        transaction_t* transaction;
+        /// Control traffic first, background traffic only when nothing else waits
+        if (!control_queue_.pop(transaction) && !config_queue_.pop(transaction) && !background_queue_.pop(transaction))
+            continue;
+        if ((transaction->state.load() & STATE_MASK) == CANCELLED) {
+            /// execute() gave up on it, nobody waits for its answer
+            release(transaction);
+            continue;
+        }
+        if (!transaction->async && transaction->traffic == TransactionPolicy::BACKGROUND) {
+            /// Queued behind the other traffic, the poll must still end before the deadline
+            long left_ms = (long) boost::chrono::duration_cast<boost::chrono::milliseconds>(
+                        transaction->deadline - TransactionPolicy::clock_t::now()).count();
+            transaction->timeout_ms = std::min(transaction->timeout_ms, left_ms);
+        }
+        if (!transaction->async && (TransactionPolicy::clock_t::now() > transaction->deadline || transaction->timeout_ms <= 0)) {
+            /// Late, its answer is useless
+            if (transaction->traffic == TransactionPolicy::CONTROL)
+                policy_->expired();
+            receive_.clear();
+            complete(transaction, false, receive_);
+            release(transaction);
+            continue;
+        }
+        if (process(transaction))
+            release(transaction);
+        else
+            enqueue(transaction);
+    }
+    drain();
+}
+
+void SerialExecutor::drain() {
+    transaction_t* transaction;
+    while (control_queue_.pop(transaction) || config_queue_.pop(transaction) || background_queue_.pop(transaction)) {
+        receive_.clear();
+        if (!transaction->async)
+            complete(transaction, false, receive_);
+        release(transaction);
+    }
+}
+
+void SerialExecutor::complete(transaction_t* transaction, bool success, const PacketList& receive) {
+    unsigned int queued = transaction->state.load();
+    if ((queued & STATE_MASK) != QUEUED || !transaction->state.compare_exchange_strong(queued, (queued & ~STATE_MASK) | COMPLETED))
+        return;
+    if (transaction->callback)
+        transaction->callback(success, receive);
+}
+
+bool SerialExecutor::process(transaction_t* transaction) {
+    command_stats_t* stats[PACKET_LIST_SIZE];
+    unsigned long bytes[PACKET_LIST_SIZE];
+    unsigned int commands = statistics(transaction->packet, stats, bytes);
+    if (transaction->async) {
+        TraceScope trace("tx_async", "serial");
+        countSent(transaction->packet, stats, bytes, commands);
+        serial_->sendAsyncPacket(transaction->packet);
+        return true;
+    }
+    /// The retries are sent here, to count them and time the attempt answered
+    bool success = false;
+    packet_t answer;
+    while (transaction->attempt <= transaction->repeat && !success) {
+        long long begin = Tracer::now();
+        countSent(transaction->packet, stats, bytes, commands);
+        try {
+            answer = serial_->sendSyncPacket(transaction->packet, 0, boost::posix_time::millisec(transaction->timeout_ms));
+            countReceived(answer);
+            success = true;
+        } catch (std::exception& e) {
+        }
+        long long end = Tracer::now();
+        /// Transmission and wait of the answer
+        Tracer::record("tx_rx", "serial", begin, end);
+        for (unsigned int i = 0; i < commands; ++i) {
+            if (transaction->attempt > 0)
+                stats[i]->retries.fetch_add(1, boost::memory_order_relaxed);
+            if (success)
+                stats[i]->latency.record((end - begin) / 1000);
+            else
+                stats[i]->timeouts.fetch_add(1, boost::memory_order_relaxed);
+        }
+        transaction->attempt++;
+        /// The next attempt of a configuration transaction waits for the control traffic queued meanwhile
+        if (!success && transaction->traffic == TransactionPolicy::CONFIGURATION && transaction->attempt <= transaction->repeat)
+            return false;
+    }
+    if (success) {
+        try {
+            TraceScope trace("parsing", "serial");
+            /// parsing also dispatches the answer to the callbacks of ParserPacket.
+            /// It returns a std::vector allocated for every answer, ParserPacket has
+            /// no overload that fills a list: the allocation stays on this thread,
+            /// never on the control thread that reads receive_ through the callback
+            receive_.assign(serial_->parsing(answer));
+        } catch (std::exception& e) {
+            success = false;
+        }
+    }
+    if (!success)
+        receive_.clear();
+    complete(transaction, success, receive_);
+    return true;
+}
+
+SerialExecutor::command_stats_t* SerialExecutor::find(const unsigned char* message) {
+    /// length | option | hashmap | command
+    unsigned char hashmap = message[2];
+    motor_command_map_t command;
+    command.command_message = message[3];
+    if (hashmap == HASHMAP_MOTOR)
+        command.bitset.motor = 0;
+
+    unsigned int count = commands_.load(boost::memory_order_relaxed);
+    for (unsigned int index = 0; index < count; ++index) {
+        if (command_stats_[index].hashmap == hashmap && command_stats_[index].command == command.command_message)
+            return &command_stats_[index];
+    }
+    if (count == EXECUTOR_COMMANDS)
+        return NULL;
+    command_stats_[count].hashmap = hashmap;
+    command_stats_[count].command = command.command_message;
+    commands_.store(count + 1, boost::memory_order_release);
+    return &command_stats_[count];
+}
+
+unsigned int SerialExecutor::statistics(const packet_t& packet, command_stats_t** stats, unsigned long* bytes) {
+    unsigned int found = 0;
+    size_t offset = 0;
+    while (offset + ORBUS_MESSAGE_HEAD <= packet.length && packet.buffer[offset] >= ORBUS_MESSAGE_HEAD) {
+        command_stats_t* command = find(&packet.buffer[offset]);
+        unsigned long length = packet.buffer[offset];
+        offset += length;
+        if (command == NULL)
+            continue;
+        unsigned int index = 0;
+        while (index < found && stats[index] != command)
+            index++;
+        if (index == found) {
+            if (found == PACKET_LIST_SIZE)
+                continue;
+            stats[found] = command;
+            bytes[found++] = 0;
+        }
+        bytes[index] += length;
+    }
+    return found;
+}
+
+void SerialExecutor::countSent(const packet_t& packet, command_stats_t** stats, const unsigned long* bytes, unsigned int commands) {
+    sent_.fetch_add(ORBUS_FRAME_HEAD + packet.length + ORBUS_FRAME_TAIL, boost::memory_order_relaxed);
+    sent_frames_.fetch_add(1, boost::memory_order_relaxed);
+    for (unsigned int i = 0; i < commands; ++i)
+        stats[i]->sent.fetch_add(bytes[i], boost::memory_order_relaxed);
+}
+
+void SerialExecutor::countReceived(const packet_t& packet) {
+    received_.fetch_add(ORBUS_FRAME_HEAD + packet.length + ORBUS_FRAME_TAIL, boost::memory_order_relaxed);
+    received_frames_.fetch_add(1, boost::memory_order_relaxed);
+    size_t offset = 0;
+    while (offset + ORBUS_MESSAGE_HEAD <= packet.length && packet.buffer[offset] >= ORBUS_MESSAGE_HEAD) {
+        command_stats_t* command = find(&packet.buffer[offset]);
+        if (command != NULL)
+            command->received.fetch_add(packet.buffer[offset], boost::memory_order_relaxed);
+        offset += packet.buffer[offset];
+    }
+}
@@ -0,0 +1,163 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#include "transport/StartupPlanner.h"
+
+using namespace std;
+
+namespace
+{
+  /// run() waits the end of post()
+  struct wait_t {
+      boost::interprocess::interprocess_semaphore done;
+      unsigned int lost;
+
+      wait_t() : done(0), lost(0) {
+      }
+
+      void complete(unsigned int lost) {
+          this->lost = lost;
+          done.post();
+      }
+  };
+}
+
+StartupPlanner::StartupPlanner(ParserPacket* serial, SerialExecutor* executor)
+: serial_(serial), executor_(executor), remaining_(0) {
+}
+
+void StartupPlanner::add(const packet_information_t& packet, const callback_reply_t& callback) {
+    request_t request;
+    request.packet = packet;
+    request.callback = callback;
+    request.answered = false;
+    requests_.push_back(request);
+}
+
+void StartupPlanner::clear() {
+    requests_.clear();
+}
+
+unsigned int StartupPlanner::run() {
+    wait_t wait;
+    post(boost::bind(&wait_t::complete, &wait, _1));
+    wait.done.wait();
+    return wait.lost;
+}
+
+void StartupPlanner::post(const callback_done_t& done) {
+    done_ = done;
+    vector<pair<size_t, size_t> > ranges = split();
+    frames_.resize(ranges.size());
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        frames_[i].begin = ranges[i].first;
+        frames_[i].end = ranges[i].second;
+        frames_[i].success = false;
+        frames_[i].receive.clear();
+    }
+    if (frames_.empty()) {
+        finish();
+        return;
+    }
+    size_t number = frames_.size();
+    remaining_ = number;
+    /// All frames are queued together, the executor sends them back to back.
+    /// The last answer can release the planner, only locals are used after the last submit
+    for (size_t i = 0; i < number; ++i) {
+        vector<packet_information_t> list_send;
+        for (size_t j = frames_[i].begin; j < frames_[i].end; ++j)
+            list_send.push_back(requests_[j].packet);
+        if (!executor_->submit(TransactionPolicy::CONFIGURATION, serial_->encoder(list_send),
+                               boost::bind(&StartupPlanner::complete, this, i, _1, _2))) {
+            PacketList empty;
+            complete(i, false, empty);
+        }
+    }
+}
+
+void StartupPlanner::complete(size_t index, bool success, const PacketList& receive) {
+    frames_[index].success = success;
+    frames_[index].receive.assign(receive.begin(), receive.end());
+    if (--remaining_ == 0)
+        finish();
+}
+
+void StartupPlanner::finish() {
+    for (vector<frame_t>::iterator it = frames_.begin(); it != frames_.end(); ++it) {
+        if (it->success)
+            dispatch(it->begin, it->end, it->receive);
+    }
+    unsigned int lost = 0;
+    for (vector<request_t>::iterator it = requests_.begin(); it != requests_.end(); ++it) {
+        if (!it->answered)
+            lost++;
+    }
+    /// done can release the planner
+    callback_done_t done;
+    done.swap(done_);
+    if (done)
+        done(lost);
+}
+
+std::vector<std::pair<size_t, size_t> > StartupPlanner::split() {
+    const size_t capacity = sizeof(((packet_t*) NULL)->buffer);
+    vector<pair<size_t, size_t> > ranges;
+    size_t begin = 0, length = 0;
+    for (size_t i = 0; i < requests_.size(); ++i) {
+        /// A message alone in a frame also counts the header, the sum is an upper bound
+        size_t size = serial_->encoder(requests_[i].packet).length;
+        if (i > begin && length + size > capacity) {
+            ranges.push_back(make_pair(begin, i));
+            begin = i;
+            length = 0;
+        }
+        length += size;
+    }
+    if (begin < requests_.size())
+        ranges.push_back(make_pair(begin, requests_.size()));
+    return ranges;
+}
+
+void StartupPlanner::dispatch(size_t begin, size_t end, const std::vector<packet_information_t>& receive) {
+    for (vector<packet_information_t>::const_iterator it = receive.begin(); it != receive.end(); ++it) {
+        /// The first message of the frame still without answer, with the same hashmap and command
+        for (size_t i = begin; i < end; ++i) {
+            request_t& request = requests_[i];
+            if (request.answered || request.packet.type != it->type || request.packet.command != it->command)
+                continue;
+            request.answered = true;
+            if (request.callback)
+                request.callback(*it);
+            break;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+#include "transport/TransactionPolicy.h"
+
+#include <algorithm>
+
+/// Shortest timeout of a serial transaction [ms]
+#define MIN_TIMEOUT_MS 1
+
+TransactionPolicy::TransactionPolicy()
+: period_(boost::chrono::milliseconds(100)), control_budget_(boost::chrono::milliseconds(80)), control_repeat_(1),
+  config_repeat_(3), config_timeout_ms_(200), deadline_(clock_t::now().time_since_epoch().count()), dropped_(0) {
+}
+
+void TransactionPolicy::setControl(double period, double ratio, unsigned int repeat) {
+    period_ = boost::chrono::duration_cast<clock_t::duration>(boost::chrono::duration<double>(period));
+    control_budget_ = boost::chrono::duration_cast<clock_t::duration>(boost::chrono::duration<double>(period * ratio));
+    control_repeat_ = repeat;
+}
+
+void TransactionPolicy::setConfiguration(unsigned int repeat, unsigned int timeout_ms) {
+    config_repeat_ = repeat;
+    config_timeout_ms_ = timeout_ms;
+}
+
+void TransactionPolicy::startCycle() {
+    deadline_.store((clock_t::now() + control_budget_).time_since_epoch().count(), boost::memory_order_release);
+}
+
+bool TransactionPolicy::schedule(traffic_t traffic, attempt_t* attempt) {
+    clock_t::time_point now = clock_t::now();
+    if (traffic == CONFIGURATION) {
+        /// Every attempt is queued again after the control traffic, and waits at most one period
+        long period_ms = (long) boost::chrono::duration_cast<boost::chrono::milliseconds>(period_).count();
+        long timeout_ms = std::max(std::min((long) config_timeout_ms_, period_ms), (long) MIN_TIMEOUT_MS);
+        attempt->repeat = config_repeat_;
+        attempt->timeout = boost::posix_time::millisec(timeout_ms);
+        /// Each attempt can wait a whole cycle of control traffic before its turn
+        attempt->deadline = now + (period_ + boost::chrono::milliseconds(timeout_ms)) * (config_repeat_ + 1);
+        return true;
+    }
+    /// Time left in this cycle, shared between all attempts
+    /// The measure stream schedules from its own thread
+    clock_t::time_point deadline(clock_t::duration(deadline_.load(boost::memory_order_acquire)));
+    long left_ms = (long) boost::chrono::duration_cast<boost::chrono::milliseconds>(deadline - now).count();
+    attempt->deadline = deadline;
+    if (traffic == BACKGROUND) {
+        /// Never retried, and never counted as dropped
+        attempt->repeat = 0;
+        attempt->timeout = boost::posix_time::millisec(left_ms);
+        return left_ms >= MIN_TIMEOUT_MS;
+    }
+    if (left_ms < MIN_TIMEOUT_MS) {
+        dropped_++;
+        return false;
+    }
+    unsigned int repeat = control_repeat_;
+    while (repeat > 0 && left_ms / (long) (repeat + 1) < MIN_TIMEOUT_MS)
+        repeat--;
+    attempt->repeat = repeat;
+    attempt->timeout = boost::posix_time::millisec(left_ms / (repeat + 1));
+    return true;
+}
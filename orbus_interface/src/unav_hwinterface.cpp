@@ -8,13 +8,42 @@
 #include <ros/ros.h>
 #include "hardware/ORBHardware.h"
 #include "hardware/UNAVHardware.h"
+#include "realtime/RealtimeLoop.h"
+#include "realtime/Tracer.h"
 #include "controller_manager/controller_manager.h"
 #include "ros/callback_queue.h"
+#include <std_srvs/Empty.h>
+
+#include <signal.h>
 
 #include <boost/chrono.hpp>
 
 typedef boost::chrono::steady_clock time_source;
 
+/// Set by SIGUSR1, the trace is written by the diagnostic loop
+volatile sig_atomic_t trace_requested = 0;
+/// File of the trace
+std::string trace_path;
+
+void requestTrace(int)
+{
+  trace_requested = 1;
+}
+
+void dumpTrace()
+{
+  if (Tracer::dump(trace_path))
+    ROS_INFO("Trace written in %s", trace_path.c_str());
+  else
+    ROS_WARN("Cannot write the trace in %s", trace_path.c_str());
+}
+
+bool dumpTraceCallback(std_srvs::Empty::Request&, std_srvs::Empty::Response&)
+{
+  dumpTrace();
+  return true;
+}
+
 /**
 * Control loop not realtime safe
 */
@@ -29,11 +58,36 @@ void controlLoop(UNAVHardware &orb,
   ros::Duration elapsed(elapsed_duration.count());
   last_time = this_time;
 
-  // Process control loop
-  orb.reportLoopDuration(elapsed);
-  orb.updateJointsFromHardware();
-  cm.update(ros::Time::now(), elapsed);
-  orb.writeCommandsToHardware(elapsed);
+  // Process control loop, the first tick registers the spinner thread of the ROS timer
+  Tracer::thread("control");
+  TraceScope trace_cycle("cycle", "control");
+  {
+    TraceScope trace("reportLoopDuration", "control");
+    orb.reportLoopDuration(elapsed);
+  }
+  AllocationCounter::sample_t start = AllocationCounter::sample();
+  {
+    TraceScope trace("updateJointsFromHardware", "control");
+    orb.updateJointsFromHardware();
+  }
+  AllocationCounter::sample_t read = AllocationCounter::sample();
+  {
+    TraceScope trace("cm.update", "control");
+    cm.update(ros::Time::now(), elapsed);
+  }
+  AllocationCounter::sample_t update = AllocationCounter::sample();
+  {
+    TraceScope trace("writeCommandsToHardware", "control");
+    orb.writeCommandsToHardware(elapsed);
+  }
+  AllocationCounter::sample_t write = AllocationCounter::sample();
+
+  // Allocations of every phase, zero if not counted
+  orb.reportAllocations(ORBHardware::LOOP_READ, read - start);
+  orb.reportAllocations(ORBHardware::LOOP_UPDATE, update - read);
+  orb.reportAllocations(ORBHardware::LOOP_WRITE, write - update);
+  boost::chrono::duration<double> cycle_duration = time_source::now() - this_time;
+  orb.reportCycleDuration(ros::Duration(cycle_duration.count()));
 }
 
 /**
@@ -42,6 +96,10 @@ void controlLoop(UNAVHardware &orb,
 void diagnosticLoop(UNAVHardware &orb)
 {
   orb.updateDiagnostics();
+  if (trace_requested) {
+    trace_requested = 0;
+    dumpTrace();
+  }
 }
 
 int main(int argc, char **argv) {
@@ -53,6 +111,21 @@ int main(int argc, char **argv) {
     double control_frequency, diagnostic_frequency;
     private_nh.param<double>("control_frequency", control_frequency, 10.0);
     private_nh.param<double>("diagnostic_frequency", diagnostic_frequency, 10.0);
+    //Run the control loop on a dedicated realtime thread
+    bool realtime;
+    private_nh.param<bool>("realtime/enable", realtime, false);
+    //Trace of the control loop and of the serial transactions
+    bool trace;
+    int trace_events;
+    private_nh.param<bool>("trace/enable", trace, false);
+    private_nh.param<int>("trace/events", trace_events, 8192);
+    private_nh.param<std::string>("trace/path", trace_path, "/tmp/unav_trace.json");
+    Tracer::enable(trace, trace_events);
+    ros::ServiceServer trace_service;
+    if (trace) {
+        trace_service = private_nh.advertiseService("dump_trace", dumpTraceCallback);
+        signal(SIGUSR1, requestTrace);
+    }
 
     //Serial port configuration
     std::string serial_port_string;
@@ -77,19 +150,42 @@ int main(int argc, char **argv) {
         UNAVHardware interface(nh, private_nh, serial);
         controller_manager::ControllerManager cm(&interface, nh);
 
-        // Setup separate queue and single-threaded spinner to process timer callbacks
-        // that interface with Husky hardware - libhorizon_legacy not threadsafe. This
-        // avoids having to lock around hardware access, but precludes realtime safety
-        // in the control loop.
+        // Separate queue and single-threaded spinner for the timers of the driver: the
+        // diagnostic loop, the measure stream and, without realtime/enable, the control
+        // loop never run concurrently with each other. With realtime/enable the control
+        // loop has its own thread, concurrently with this queue: what the diagnostic
+        // loop shares with it is atomic, triple buffered or locked by the driver.
         ros::CallbackQueue unav_queue;
         ros::AsyncSpinner unav_spinner(1, &unav_queue);
 
         time_source::time_point last_time = time_source::now();
-        ros::TimerOptions control_timer(
-                    ros::Duration(1 / control_frequency),
-                    boost::bind(controlLoop, boost::ref(interface), boost::ref(cm), boost::ref(last_time)),
-                    &unav_queue);
-        ros::Timer control_loop = nh.createTimer(control_timer);
+        ros::Timer control_loop;
+        boost::shared_ptr<RealtimeLoop> realtime_loop;
+        if (realtime) {
+            // Dedicated thread that sleeps to absolute deadlines
+            RealtimeLoop::options_t options;
+            std::string overrun;
+            int stack_prefault;
+            private_nh.param<int>("realtime/priority", options.priority, 0);
+            private_nh.param<int>("realtime/cpu", options.cpu, -1);
+            private_nh.param<bool>("realtime/lock_memory", options.lock_memory, true);
+            private_nh.param<int>("realtime/stack_prefault", stack_prefault, 64 * 1024);
+            private_nh.param<std::string>("realtime/overrun", overrun, "skip");
+            options.stack_prefault = stack_prefault;
+            options.overrun = RealtimeLoop::overrunFromString(overrun);
+            realtime_loop.reset(new RealtimeLoop(control_frequency,
+                                                 boost::bind(controlLoop, boost::ref(interface), boost::ref(cm), boost::ref(last_time)),
+                                                 options));
+            ROS_INFO("Realtime control loop, priority: %d cpu: %d", options.priority, options.cpu);
+        } else {
+            ros::TimerOptions control_timer(
+                        ros::Duration(1 / control_frequency),
+                        boost::bind(controlLoop, boost::ref(interface), boost::ref(cm), boost::ref(last_time)),
+                        &unav_queue);
+            control_loop = nh.createTimer(control_timer);
+        }
+
+        interface.startStream(&unav_queue);
 
         ros::TimerOptions diagnostic_timer(
                     ros::Duration(1 / diagnostic_frequency),
@@ -98,6 +194,8 @@ int main(int argc, char **argv) {
         ros::Timer diagnostic_loop = nh.createTimer(diagnostic_timer);
 
         unav_spinner.start();
+        if (realtime_loop)
+            realtime_loop->start();
 
         std::string name_node = ros::this_node::getName();
         ROS_INFO("Started %s", name_node.c_str());
@@ -105,6 +203,9 @@ int main(int argc, char **argv) {
         // Process remainder of ROS callbacks separately, mainly ControlManager related
         ros::spin();
 
+        if (realtime_loop)
+            realtime_loop->stop();
+
     } catch (std::exception &e) {
         serial->close();
         ROS_ERROR("%s", e.what());
@@ -0,0 +1,114 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include "hardware/UNAVHardware.h"
+#include "realtime/AllocationCounter.h"
+#include "emulator/EmulatorLoop.h"
+
+#include <boost/chrono.hpp>
+
+typedef boost::chrono::steady_clock time_source;
+
+namespace
+{
+  /// Control frequency and serial rate of the test [Hz], [baud]
+  const double FREQUENCY = 50.0;
+  const double RATE = 115200.0;
+  /// Ticks before and during the measure
+  const unsigned int WARMUP = 100;
+  const unsigned int TICKS = 200;
+}
+
+/**
+ * After the warmup, the read and write phases of the control loop never
+ * allocate, against the emulated board
+ */
+TEST(ControlLoop, noAllocationsAfterWarmup) {
+    ASSERT_TRUE(AllocationCounter::enabled());
+
+    PtyLink::impairment_t impairment;
+    impairment.baud = (unsigned int) RATE;
+    impairment.latency = 0.5;
+    PtyLink link(impairment);
+    ASSERT_TRUE(link.open());
+    BoardEmulator board;
+    EmulatorLoop emulator(&board, &link);
+    emulator.start();
+
+    ros::NodeHandle nh, private_nh("~");
+    private_nh.setParam("serial_port", link.name());
+    private_nh.setParam("serial_rate", RATE);
+    private_nh.setParam("control_frequency", FREQUENCY);
+    private_nh.setParam("config_cache", false);
+
+    ParserPacket* serial = new ParserPacket(link.name().c_str(), RATE);
+    {
+        UNAVHardware interface(nh, private_nh, serial);
+
+        AllocationCounter::sample_t allocations[ORBHardware::LOOP_PHASES];
+        ros::Duration period(1.0 / FREQUENCY);
+        time_source::time_point tick = time_source::now();
+        for (unsigned int i = 0; i < WARMUP + TICKS; ++i) {
+            interface.reportLoopDuration(period);
+            AllocationCounter::sample_t start = AllocationCounter::sample();
+            interface.updateJointsFromHardware();
+            AllocationCounter::sample_t read = AllocationCounter::sample();
+            interface.writeCommandsToHardware(period);
+            AllocationCounter::sample_t write = AllocationCounter::sample();
+            if (i >= WARMUP) {
+                allocations[ORBHardware::LOOP_READ].count += (read - start).count;
+                allocations[ORBHardware::LOOP_WRITE].count += (write - read).count;
+            }
+            tick += boost::chrono::duration_cast<time_source::duration>(boost::chrono::duration<double>(1.0 / FREQUENCY));
+            boost::this_thread::sleep_until(tick);
+        }
+
+        EXPECT_EQ(0u, allocations[ORBHardware::LOOP_READ].count);
+        EXPECT_EQ(0u, allocations[ORBHardware::LOOP_WRITE].count);
+        /// The ticks measured really talked to the board
+        EXPECT_GT(board.frames(), TICKS);
+    }
+    serial->close();
+    delete serial;
+    emulator.stop();
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    ros::init(argc, argv, "test_allocations");
+    /// Timers of the driver
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+    return RUN_ALL_TESTS();
+}
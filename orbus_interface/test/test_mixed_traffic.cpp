@@ -0,0 +1,138 @@
+/**
+*
+*  \author     Raffaello Bonghi <raffaello.bonghi@officinerobotiche.it>
+*  \copyright  Copyright (c) 2014-2015, Officine Robotiche, Inc.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above copyright
+*       notice, this list of conditions and the following disclaimer in the
+*       documentation and/or other materials provided with the distribution.
+*     * Neither the name of Officine Robotiche, Inc. nor the
+*       names of its contributors may be used to endorse or promote products
+*       derived from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+* ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+* WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL OFFICINE ROBOTICHE, INC. BE LIABLE FOR ANY
+* DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+* ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+* SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+* Please send comments, questions, or patches to developers@officinerobotiche.it
+*
+*/
+
+
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+#include "hardware/UNAVHardware.h"
+#include "emulator/EmulatorLoop.h"
+
+#include <math.h>
+#include <map>
+
+#include <boost/chrono.hpp>
+
+typedef boost::chrono::steady_clock time_source;
+
+namespace
+{
+  /// Control frequency and serial rate of the test [Hz], [baud]
+  const double FREQUENCY = 50.0;
+  const double RATE = 115200.0;
+  /// Ticks with the motors moving, and stopped before the check
+  const unsigned int MOVING = 150;
+  const unsigned int STOPPED = 50;
+
+  /**
+   * Drive the motors with the answers decoded on the executor and on the
+   * receive thread at once, then compare the position of every joint with
+   * the position sent by the board [thousandths of rad]
+   * @param window requests in flight, 0 without the window
+   */
+  void runMixedTraffic(const std::string& name, const std::map<std::string, bool>& options, int window) {
+      PtyLink::impairment_t impairment;
+      impairment.baud = (unsigned int) RATE;
+      impairment.latency = 0.5;
+      PtyLink link(impairment);
+      ASSERT_TRUE(link.open());
+      BoardEmulator board;
+      EmulatorLoop emulator(&board, &link);
+      emulator.start();
+
+      /// Every run in its namespace, the dynamic reconfigure servers never meet
+      ros::NodeHandle nh, private_nh("~" + name);
+      for (std::map<std::string, bool>::const_iterator it = options.begin(); it != options.end(); ++it)
+          private_nh.setParam(it->first, it->second);
+      private_nh.setParam("pipeline_window", window);
+      private_nh.setParam("serial_port", link.name());
+      private_nh.setParam("serial_rate", RATE);
+      private_nh.setParam("control_frequency", FREQUENCY);
+      private_nh.setParam("config_cache", false);
+
+      ParserPacket* serial = new ParserPacket(link.name().c_str(), RATE);
+      double position[NUM_MOTORS];
+      {
+          UNAVHardware interface(nh, private_nh, serial);
+          hardware_interface::VelocityJointInterface* velocity = interface.get<hardware_interface::VelocityJointInterface>();
+          ASSERT_TRUE(velocity != NULL);
+          std::vector<std::string> joints = velocity->getNames();
+          ASSERT_EQ((size_t) NUM_MOTORS, joints.size());
+
+          ros::Duration period(1.0 / FREQUENCY);
+          time_source::time_point tick = time_source::now();
+          for (unsigned int i = 0; i < MOVING + STOPPED; ++i) {
+              for (int j = 0; j < NUM_MOTORS; ++j)
+                  velocity->getHandle(joints[j]).setCommand((i < MOVING) ? 0.5 * (j + 1) : 0.0);
+              interface.reportLoopDuration(period);
+              interface.updateJointsFromHardware();
+              interface.writeCommandsToHardware(period);
+              tick += boost::chrono::duration_cast<time_source::duration>(boost::chrono::duration<double>(1.0 / FREQUENCY));
+              boost::this_thread::sleep_until(tick);
+          }
+          for (int j = 0; j < NUM_MOTORS; ++j)
+              position[j] = velocity->getHandle(joints[j]).getPosition();
+      }
+      serial->close();
+      delete serial;
+      emulator.stop();
+
+      for (int j = 0; j < NUM_MOTORS; ++j) {
+          /// The motors moved, and no position delta was lost or counted twice
+          EXPECT_GT(fabs(board.positionSent(j)), 0.1);
+          EXPECT_NEAR(board.positionSent(j) * 1000, position[j], 1.0) << "motor " << j;
+      }
+  }
+}
+
+/// Measures on the receive thread from the window, status polled on the executor thread
+TEST(MixedTraffic, windowAndStatusPolling) {
+    std::map<std::string, bool> options;
+    options["status_polling"] = true;
+    runMixedTraffic("window", options, 4);
+}
+
+/// Measures in the asynchronous frame of the references, status polled on the executor thread
+TEST(MixedTraffic, combinedAsyncCommands) {
+    std::map<std::string, bool> options;
+    options["combined_transaction"] = true;
+    options["async_commands"] = true;
+    options["status_polling"] = true;
+    runMixedTraffic("combined_async", options, 0);
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    ros::init(argc, argv, "test_mixed_traffic");
+    /// Timers of the driver
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+    return RUN_ALL_TESTS();
+}